@@ -11,6 +11,7 @@
 #define REL_TPOFF       R_386_TLS_TPOFF
 #define REL_TPOFF_NEG   R_386_TLS_TPOFF32
 #define REL_TLSDESC     R_386_TLS_DESC
+#define REL_IRELATIVE   R_386_IRELATIVE
 
 #define CRTJMP(pc,sp) __asm__ __volatile__( \
 	"mov %1,%%esp ; jmp *%0" : : "r"(pc), "r"(sp) : "memory" )
@@ -0,0 +1,9 @@
+#define CPU_SSSE3 1
+#define CPU_SSE42 2
+#define CPU_AVX2  4
+#define CPU_ERMS  8
+
+extern unsigned __cpu_features ATTR_LIBC_VISIBILITY;
+
+/* Size from which memcpy and memset use non-temporal stores */
+extern size_t __nt_store_min ATTR_LIBC_VISIBILITY;
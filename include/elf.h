@@ -2482,6 +2482,7 @@ enum
 #define R_AARCH64_TLS_TPREL    1030
 #define R_AARCH64_TLS_TPREL64  1030
 #define R_AARCH64_TLSDESC      1031
+#define R_AARCH64_IRELATIVE    1032
 
 
 #define R_ARM_NONE		0
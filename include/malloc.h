@@ -17,6 +17,75 @@ void *valloc (size_t);
 void *memalign(size_t, size_t);
 
 size_t malloc_usable_size(void *);
+int malloc_trim(size_t);
+
+size_t malloc_bulk(size_t, size_t, void **);
+void free_bulk(size_t, void **);
+void free_sized(void *, size_t);
+
+struct mallinfo {
+	int arena;
+	int ordblks;
+	int smblks;
+	int hblks;
+	int hblkhd;
+	int usmblks;
+	int fsmblks;
+	int uordblks;
+	int fordblks;
+	int keepcost;
+};
+
+struct mallinfo2 {
+	size_t arena;
+	size_t ordblks;
+	size_t smblks;
+	size_t hblks;
+	size_t hblkhd;
+	size_t usmblks;
+	size_t fsmblks;
+	size_t uordblks;
+	size_t fordblks;
+	size_t keepcost;
+};
+
+#define MALLOC_SAMPLE_DEPTH 16
+
+struct malloc_sample {
+	size_t seq;
+	size_t size;
+	void *caller;
+	size_t depth;
+	void *stack[MALLOC_SAMPLE_DEPTH];
+};
+
+size_t malloc_profile_read(struct malloc_sample *, size_t, size_t *);
+int malloc_profile_dump(int);
+
+/* An arena must not be used by more than one thread at a time.
+ * malloc_arena_destroy only clears the calling thread's selection;
+ * other threads must deselect an arena before it is destroyed. */
+typedef struct __malloc_arena malloc_arena_t;
+
+malloc_arena_t *malloc_arena_create(size_t);
+void *malloc_arena_alloc(malloc_arena_t *, size_t);
+void *malloc_arena_alloc_aligned(malloc_arena_t *, size_t, size_t);
+void malloc_arena_reset(malloc_arena_t *);
+void malloc_arena_destroy(malloc_arena_t *);
+malloc_arena_t *malloc_arena_select(malloc_arena_t *);
+
+struct mallinfo mallinfo(void);
+struct mallinfo2 mallinfo2(void);
+void malloc_stats(void);
+
+#define M_TRIM_THRESHOLD (-1)
+#define M_TOP_PAD (-2)
+#define M_MMAP_THRESHOLD (-3)
+#define M_PURGE_DECAY (-100)
+#define M_HUGEPAGE (-101)
+#define M_PROFILE_RATE (-102)
+
+int mallopt(int, int);
 
 #ifdef __cplusplus
 }
@@ -176,6 +176,7 @@ int fileno_unlocked(FILE *);
 int getw(FILE *);
 int putw(int, FILE *);
 char *fgetln(FILE *, size_t *);
+size_t fgetlns(FILE *, char **, size_t *, size_t);
 int asprintf(char **, const char *, ...);
 int vasprintf(char **, const char *, __isoc_va_list);
 #endif
@@ -197,6 +198,15 @@ typedef struct _IO_cookie_io_functions_t {
 } cookie_io_functions_t;
 
 FILE *fopencookie(void *, const char *, cookie_io_functions_t);
+
+typedef struct __printf_plan printf_plan_t;
+printf_plan_t *printf_plan_create(const char *);
+void printf_plan_free(printf_plan_t *);
+int fprintf_plan(FILE *__restrict, const printf_plan_t *, ...);
+int vfprintf_plan(FILE *__restrict, const printf_plan_t *, __isoc_va_list);
+int snprintf_plan(char *__restrict, size_t, const printf_plan_t *, ...);
+int vsnprintf_plan(char *__restrict, size_t, const printf_plan_t *, __isoc_va_list);
+int printf_plan_cache(int);
 #endif
 
 #if defined(_LARGEFILE64_SOURCE) || defined(_GNU_SOURCE)
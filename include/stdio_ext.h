@@ -25,7 +25,11 @@ int __fpurge(FILE *);
 size_t __freadahead(FILE *);
 const char *__freadptr(FILE *, size_t *);
 void __freadptrinc(FILE *, size_t);
+const char *__freadpeek(FILE *, size_t *);
+char *__fwriteptr(FILE *, size_t, size_t *);
+void __fwriteptrinc(FILE *, size_t);
 void __fseterr(FILE *);
+int __fsetwritebehind(FILE *, int);
 
 #ifdef __cplusplus
 }
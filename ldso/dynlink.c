@@ -64,6 +64,7 @@ struct dso {
 	dev_t dev;
 	ino_t ino;
 	char relocated;
+	char ifuncs;
 	char constructed;
 	char kernel_mapped;
 	struct dso **deps, *needed_by;
@@ -269,7 +270,7 @@ static Sym *gnu_lookup_filtered(uint32_t h1, uint32_t *hashtab, struct dso *dso,
 	return gnu_lookup(h1, hashtab, dso, s);
 }
 
-#define OK_TYPES (1<<STT_NOTYPE | 1<<STT_OBJECT | 1<<STT_FUNC | 1<<STT_COMMON | 1<<STT_TLS)
+#define OK_TYPES (1<<STT_NOTYPE | 1<<STT_OBJECT | 1<<STT_FUNC | 1<<STT_COMMON | 1<<STT_TLS | 1<<STT_GNU_IFUNC)
 #define OK_BINDS (1<<STB_GLOBAL | 1<<STB_WEAK | 1<<STB_GNU_UNIQUE)
 
 #ifndef ARCH_SYM_REJECT_UND
@@ -309,6 +310,22 @@ static struct symdef find_sym(struct dso *dso, const char *s, int need_def)
 __attribute__((__visibility__("hidden")))
 ptrdiff_t __tlsdesc_static(), __tlsdesc_dynamic();
 
+/* IFUNC resolvers receive AT_HWCAP, as on other ELF systems. They run
+ * before any constructors, so they should only inspect their argument
+ * and data of their own DSO. */
+static size_t ifunc_resolve(size_t resolver)
+{
+	return ((size_t (*)(size_t))resolver)(__hwcap);
+}
+
+static void *sym_addr(struct dso *p, Sym *sym)
+{
+	void *addr = laddr(p, sym->st_value);
+	if ((sym->st_info&0xf) == STT_GNU_IFUNC)
+		addr = (void *)ifunc_resolve((size_t)addr);
+	return addr;
+}
+
 static void do_relocs(struct dso *dso, size_t *rel, size_t rel_size, size_t stride)
 {
 	unsigned char *base = dso->base;
@@ -382,7 +399,17 @@ static void do_relocs(struct dso *dso, size_t *rel, size_t rel_size, size_t stri
 			def.dso = dso;
 		}
 
-		sym_val = def.sym ? (size_t)laddr(def.dso, def.sym->st_value) : 0;
+		/* References to IFUNC definitions are left for do_ifuncs,
+		 * so that the defining DSO is relocated first. */
+		if (def.sym && (def.sym->st_info&0xf) == STT_GNU_IFUNC
+		    && !dso->relocated && !reuse_addends
+		    && (type==REL_SYMBOLIC || type==REL_GOT
+		        || type==REL_PLT || type==REL_SYM_OR_REL)) {
+			dso->ifuncs = 1;
+			continue;
+		}
+
+		sym_val = def.sym ? (size_t)sym_addr(def.dso, def.sym) : 0;
 		tls_val = def.sym ? def.sym->st_value : 0;
 
 		switch(type) {
@@ -398,6 +425,10 @@ static void do_relocs(struct dso *dso, size_t *rel, size_t rel_size, size_t stri
 		case REL_RELATIVE:
 			*reloc_addr = (size_t)base + addend;
 			break;
+		case REL_IRELATIVE:
+			/* Deferred to do_ifuncs. */
+			dso->ifuncs = 1;
+			break;
 		case REL_SYM_OR_REL:
 			if (sym) *reloc_addr = sym_val + addend;
 			else *reloc_addr = (size_t)base + addend;
@@ -1209,10 +1240,55 @@ static void do_mips_relocs(struct dso *p, size_t *got)
 	}
 }
 
+/* Apply the IRELATIVE relocations and the references to IFUNC
+ * definitions that do_relocs skipped. This runs once every DSO being
+ * loaded has had its other relocations processed, so that resolvers
+ * see their own data, and data they reach through their GOT,
+ * relocated. */
+static void do_ifuncs(struct dso *dso, size_t *rel, size_t rel_size, size_t stride)
+{
+	Sym *sym;
+	struct symdef def;
+	size_t *reloc_addr, addend;
+	int type;
+
+	for (; rel_size; rel+=stride, rel_size-=stride*sizeof(size_t)) {
+		type = R_TYPE(rel[1]);
+		reloc_addr = laddr(dso, rel[0]);
+		if (type == REL_IRELATIVE) {
+			addend = stride>2 ? rel[2] : *reloc_addr;
+			*reloc_addr = ifunc_resolve((size_t)laddr(dso, addend));
+			continue;
+		}
+		if (!R_SYM(rel[1]) || (type!=REL_SYMBOLIC && type!=REL_GOT
+		    && type!=REL_PLT && type!=REL_SYM_OR_REL)) continue;
+		sym = dso->syms + R_SYM(rel[1]);
+		if ((sym->st_info&0xf) == STT_SECTION) continue;
+		def = find_sym(head, dso->strings + sym->st_name, type==REL_PLT);
+		if (!def.sym || (def.sym->st_info&0xf) != STT_GNU_IFUNC) continue;
+		if (stride > 2) addend = rel[2];
+		else if (type==REL_GOT || type==REL_PLT) addend = 0;
+		else addend = *reloc_addr;
+		*reloc_addr = (size_t)sym_addr(def.dso, def.sym) + addend;
+	}
+}
+
+static void protect_relro(struct dso *p)
+{
+	if (head != &ldso && p->relro_start != p->relro_end &&
+	    mprotect(laddr(p, p->relro_start), p->relro_end-p->relro_start, PROT_READ)
+	    && errno != ENOSYS) {
+		error("Error relocating %s: RELRO protection failed: %m",
+			p->name);
+		if (runtime) longjmp(*rtld_fail, 1);
+	}
+}
+
 static void reloc_all(struct dso *p)
 {
 	size_t dyn[DYN_CNT];
-	for (; p; p=p->next) {
+	struct dso *q;
+	for (q=p; p; p=p->next) {
 		if (p->relocated) continue;
 		decode_vec(p->dynv, dyn, DYN_CNT);
 		if (NEED_MIPS_GOT_RELOCS)
@@ -1221,17 +1297,20 @@ static void reloc_all(struct dso *p)
 			2+(dyn[DT_PLTREL]==DT_RELA));
 		do_relocs(p, laddr(p, dyn[DT_REL]), dyn[DT_RELSZ], 2);
 		do_relocs(p, laddr(p, dyn[DT_RELA]), dyn[DT_RELASZ], 3);
-
-		if (head != &ldso && p->relro_start != p->relro_end &&
-		    mprotect(laddr(p, p->relro_start), p->relro_end-p->relro_start, PROT_READ)
-		    && errno != ENOSYS) {
-			error("Error relocating %s: RELRO protection failed: %m",
-				p->name);
-			if (runtime) longjmp(*rtld_fail, 1);
-		}
-
+		if (!p->ifuncs) protect_relro(p);
 		p->relocated = 1;
 	}
+
+	for (p=q; p; p=p->next) {
+		if (!p->ifuncs) continue;
+		decode_vec(p->dynv, dyn, DYN_CNT);
+		do_ifuncs(p, laddr(p, dyn[DT_JMPREL]), dyn[DT_PLTRELSZ],
+			2+(dyn[DT_PLTREL]==DT_RELA));
+		do_ifuncs(p, laddr(p, dyn[DT_REL]), dyn[DT_RELSZ], 2);
+		do_ifuncs(p, laddr(p, dyn[DT_RELA]), dyn[DT_RELASZ], 3);
+		p->ifuncs = 0;
+		protect_relro(p);
+	}
 }
 
 static void kernel_mapped_dso(struct dso *p)
@@ -1477,6 +1556,7 @@ _Noreturn void __dls3(size_t *sp)
 	libc.auxv = auxv = (void *)(argv+i+1);
 	decode_vec(auxv, aux, AUX_CNT);
 	__hwcap = aux[AT_HWCAP];
+	__init_cpu();
 	libc.page_size = aux[AT_PAGESZ];
 	libc.secure = ((aux[0]&0x7800)!=0x7800 || aux[AT_UID]!=aux[AT_EUID]
 		|| aux[AT_GID]!=aux[AT_EGID] || aux[AT_SECURE]);
@@ -1907,7 +1987,7 @@ static void *do_dlsym(struct dso *p, const char *s, void *ra)
 			return __tls_get_addr((tls_mod_off_t []){def.dso->tls_id, def.sym->st_value});
 		if (DL_FDPIC && (def.sym->st_info&0xf) == STT_FUNC)
 			return def.dso->funcdescs + (def.sym - def.dso->syms);
-		return laddr(def.dso, def.sym->st_value);
+		return sym_addr(def.dso, def.sym);
 	}
 	if (__dl_invalid_handle(p))
 		return 0;
@@ -1923,7 +2003,7 @@ static void *do_dlsym(struct dso *p, const char *s, void *ra)
 	if (DL_FDPIC && sym && sym->st_shndx && (sym->st_info&0xf) == STT_FUNC)
 		return p->funcdescs + (sym - p->syms);
 	if (sym && sym->st_value && (1<<(sym->st_info&0xf) & OK_TYPES))
-		return laddr(p, sym->st_value);
+		return sym_addr(p, sym);
 	for (i=0; p->deps[i]; i++) {
 		if ((ght = p->deps[i]->ghashtab)) {
 			if (!gh) gh = gnu_hash(s);
@@ -1937,7 +2017,7 @@ static void *do_dlsym(struct dso *p, const char *s, void *ra)
 		if (DL_FDPIC && sym && sym->st_shndx && (sym->st_info&0xf) == STT_FUNC)
 			return p->deps[i]->funcdescs + (sym - p->deps[i]->syms);
 		if (sym && sym->st_value && (1<<(sym->st_info&0xf) & OK_TYPES))
-			return laddr(p->deps[i], sym->st_value);
+			return sym_addr(p->deps[i], sym);
 	}
 failed:
 	error("Symbol not found: %s", s);
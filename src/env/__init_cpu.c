@@ -0,0 +1,8 @@
+#include "libc.h"
+
+/* Archs whose string functions can use optional instruction set
+ * extensions replace this to probe for them. */
+
+void __init_cpu(void)
+{
+}
@@ -5,18 +5,30 @@
 #include "syscall.h"
 #include "atomic.h"
 #include "libc.h"
+#include "dynlink.h"
 
 void __init_tls(size_t *);
 
 static void dummy(void) {}
 weak_alias(dummy, _init);
+weak_alias(dummy, __malloc_init_env);
 
 __attribute__((__weak__, __visibility__("hidden")))
 extern void (*const __init_array_start)(void), (*const __init_array_end)(void);
 
+/* Bounds of the IRELATIVE relocations in static binaries */
+__attribute__((__weak__, __visibility__("hidden")))
+extern const size_t __rela_iplt_start[], __rela_iplt_end[],
+	__rel_iplt_start[], __rel_iplt_end[];
+
+/* and, with the other dynamic relocations, in static PIE ones */
+__attribute__((__weak__, __visibility__("hidden")))
+extern const size_t _DYNAMIC[];
+
 static void dummy1(void *p) {}
 weak_alias(dummy1, __init_ssp);
 
+#undef AUX_CNT
 #define AUX_CNT 38
 
 void __init_libc(char **envp, char *pn)
@@ -28,6 +40,7 @@ void __init_libc(char **envp, char *pn)
 	for (i=0; auxv[i]; i+=2) if (auxv[i]<AUX_CNT) aux[auxv[i]] = auxv[i+1];
 	__hwcap = aux[AT_HWCAP];
 	__sysinfo = aux[AT_SYSINFO];
+	__init_cpu();
 	libc.page_size = aux[AT_PAGESZ];
 
 	if (!pn) pn = (void*)aux[AT_EXECFN];
@@ -57,8 +70,56 @@ void __init_libc(char **envp, char *pn)
 	libc.secure = 1;
 }
 
+static void apply_irelative(size_t base, size_t rel, size_t size, int rela)
+{
+	const size_t *r = (void *)(base + rel), *end = r + size/sizeof *r;
+	for (; r<end; r+=2+rela) {
+		size_t *p = (void *)(base + r[0]);
+		if (R_TYPE(r[1]) != REL_IRELATIVE) continue;
+		*p = ((size_t (*)(size_t))(base + (rela ? r[2] : *p)))(__hwcap);
+	}
+}
+
+/* rcrt1 applies only the relative relocations of a static PIE binary,
+ * before libc is initialized. Its IRELATIVE relocations are left for
+ * here, so that resolvers see __hwcap like in other binaries. */
+static void static_pie_irelative(void)
+{
+	size_t i, base = 0, aux[AUX_CNT] = { 0 }, dyn[DT_JMPREL+1] = { 0 };
+	Phdr *ph;
+	int rela;
+
+	for (i=0; libc.auxv[i]; i+=2) if (libc.auxv[i]<AUX_CNT)
+		aux[libc.auxv[i]] = libc.auxv[i+1];
+	for (ph=(void *)aux[AT_PHDR], i=aux[AT_PHNUM]; i; i--,
+	     ph=(void *)((char *)ph + aux[AT_PHENT]))
+		if (ph->p_type == PT_DYNAMIC)
+			base = (size_t)_DYNAMIC - ph->p_vaddr;
+	for (i=0; _DYNAMIC[i]; i+=2) if (_DYNAMIC[i]<=DT_JMPREL)
+		dyn[_DYNAMIC[i]] = _DYNAMIC[i+1];
+
+	apply_irelative(base, dyn[DT_RELA], dyn[DT_RELASZ], 1);
+	apply_irelative(base, dyn[DT_REL], dyn[DT_RELSZ], 0);
+
+	/* The PLT relocations may be counted in the sizes above. */
+	rela = dyn[DT_PLTREL] == DT_RELA;
+	if (dyn[DT_JMPREL] - dyn[rela ? DT_RELA : DT_REL]
+	    >= dyn[rela ? DT_RELASZ : DT_RELSZ])
+		apply_irelative(base, dyn[DT_JMPREL], dyn[DT_PLTRELSZ], rela);
+}
+
 static void libc_start_init(void)
 {
+	const size_t *r;
+	if (_DYNAMIC) {
+		static_pie_irelative();
+	} else {
+		for (r=__rela_iplt_start; r<__rela_iplt_end; r+=3)
+			*(size_t *)r[0] = ((size_t (*)(size_t))r[2])(__hwcap);
+		for (r=__rel_iplt_start; r<__rel_iplt_end; r+=2)
+			*(size_t *)r[0] = ((size_t (*)(size_t))*(size_t *)r[0])(__hwcap);
+	}
+
 	_init();
 	uintptr_t a = (uintptr_t)&__init_array_start;
 	for (; a<(uintptr_t)&__init_array_end; a+=sizeof(void(*)()))
@@ -73,6 +134,7 @@ int __libc_start_main(int (*main)(int,char **,char **), int argc, char **argv,
 	char **envp = argv+argc+1;
 
 	__init_libc(envp, argv[0]);
+	__malloc_init_env();
 	__libc_start_init();
 
 	/* Pass control to the application */
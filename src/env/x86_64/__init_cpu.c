@@ -0,0 +1,115 @@
+#include <stdint.h>
+#include "libc.h"
+#include "cpu_arch.h"
+
+unsigned __cpu_features ATTR_LIBC_VISIBILITY;
+size_t __nt_store_min ATTR_LIBC_VISIBILITY = -1;
+
+/* String functions with several implementations jump through a slot
+ * initialized to their baseline version. The slots and variants are
+ * referenced weakly so that selecting them does not link in functions
+ * the program does not otherwise use. Later entries take precedence.
+ * The slots are in .data.rel.ro, which the dynamic linker protects
+ * after this runs, so in libc.so they cannot be redirected later. */
+
+typedef void fn(void);
+
+__attribute__((__weak__, __visibility__("hidden")))
+extern fn *__memchr_impl, *__memcmp_impl, *__strchrnul_impl,
+	*__strcmp_impl, *__strlen_impl;
+
+__attribute__((__weak__, __visibility__("hidden")))
+extern fn __memchr_avx2, __memcmp_avx2, __strchrnul_avx2,
+	__strcmp_avx2, __strlen_avx2;
+
+static fn **const slots[] = {
+	&__memchr_impl, &__memcmp_impl, &__strchrnul_impl,
+	&__strcmp_impl, &__strlen_impl,
+};
+
+static const struct {
+	unsigned char slot, need;
+	fn *impl;
+} impls[] = {
+	{ 0, CPU_AVX2, __memchr_avx2 },
+	{ 1, CPU_AVX2, __memcmp_avx2 },
+	{ 2, CPU_AVX2, __strchrnul_avx2 },
+	{ 3, CPU_AVX2, __strcmp_avx2 },
+	{ 4, CPU_AVX2, __strlen_avx2 },
+};
+
+static void cpuid(unsigned leaf, unsigned sub, unsigned r[4])
+{
+	__asm__ ("cpuid" : "=a"(r[0]), "=b"(r[1]), "=c"(r[2]), "=d"(r[3])
+		: "a"(leaf), "c"(sub));
+}
+
+/* Size of the largest (last level) cache, or 0 if unknown. Intel
+ * enumerates caches with leaf 4, AMD reports L2 and L3 in extended
+ * leaf 0x80000006. */
+static size_t llc_size(unsigned max, unsigned vendor)
+{
+	unsigned r[4], i;
+	size_t n, llc = 0;
+
+	if (vendor == 0x756e6547 && max >= 4) {
+		for (i=0; i<16; i++) {
+			cpuid(4, i, r);
+			if (!(r[0] & 31)) break;
+			n = (size_t)((r[1]>>22) + 1) * (((r[1]>>12) & 0x3ff) + 1)
+				* ((r[1] & 0xfff) + 1) * (r[2] + 1);
+			if (n > llc) llc = n;
+		}
+	} else if (vendor == 0x68747541) {
+		cpuid(0x80000000, 0, r);
+		if (r[0] < 0x80000006) return 0;
+		cpuid(0x80000006, 0, r);
+		llc = (size_t)(r[2]>>16) << 10;
+		n = (size_t)(r[3]>>18) << 19;
+		if (n > llc) llc = n;
+	}
+	return llc;
+}
+
+void __init_cpu(void)
+{
+	unsigned r[4], max, vendor, f = 0;
+	uint32_t xcr0, hi;
+	size_t i, llc;
+	fn *sel[sizeof slots/sizeof *slots] = { 0 };
+
+	cpuid(0, 0, r);
+	max = r[0];
+	vendor = r[1];
+	cpuid(1, 0, r);
+	if (r[2] & 1<<9) f |= CPU_SSSE3;
+	if (r[2] & 1<<20) f |= CPU_SSE42;
+	/* OSXSAVE and AVX, with xmm and ymm state saved by the kernel */
+	int avx = (r[2] & 3<<27) == 3<<27;
+	if (avx) {
+		__asm__ ("xgetbv" : "=a"(xcr0), "=d"(hi) : "c"(0));
+		avx = (xcr0 & 6) == 6;
+	}
+	if (max >= 7) {
+		cpuid(7, 0, r);
+		if (avx && (r[1] & 1<<5)) f |= CPU_AVX2;
+		if (r[1] & 1<<9) f |= CPU_ERMS;
+	}
+	__cpu_features = f;
+
+	/* Copies much larger than the cache would only evict the working
+	 * set on their way through it; bypass it from 3/4 of its size. */
+	if ((llc = llc_size(max, vendor)))
+		__nt_store_min = llc/4*3;
+
+	for (i=0; i<sizeof impls/sizeof *impls; i++)
+		if (impls[i].impl && (f & impls[i].need) == impls[i].need)
+			sel[impls[i].slot] = impls[i].impl;
+
+	/* In a dynamically linked program this runs again from
+	 * __init_libc after the slots have been made read-only, and
+	 * then must not store to them. */
+	for (i=0; i<sizeof slots/sizeof *slots; i++)
+		if (slots[i] && sel[i] && *slots[i] != sel[i])
+			*slots[i] = sel[i];
+}
@@ -40,6 +40,7 @@ enum {
 	REL_TLSDESC,
 	REL_FUNCDESC,
 	REL_FUNCDESC_VAL,
+	REL_IRELATIVE,
 };
 
 struct fdpic_loadseg {
@@ -0,0 +1,256 @@
+#include <stdint.h>
+#include "atomic.h"
+#include "fpdigits.h"
+
+/* Decimal digits of positive finite doubles after Loitsch's Grisu: the
+ * value is scaled by a cached power of ten to a 64-bit fixed point
+ * number whose integer part fits in 32 bits, and digits are peeled off
+ * with integer arithmetic. The scaling is off by up to one unit in the
+ * last place, so digits are only returned when the error bound shows
+ * them to be the right ones. Otherwise the functions return 0 and the
+ * caller has to use exact arithmetic, which happens for well under one
+ * percent of inputs. */
+
+struct fp {
+	uint64_t f;
+	int e;
+};
+
+/* 10^k rounded to 64 bits, for k = -348, -340, ..., 340 */
+static const struct fp pow10[] = {
+	{ 0xfa8fd5a0081c0288, -1220 }, { 0xbaaee17fa23ebf76, -1193 },
+	{ 0x8b16fb203055ac76, -1166 }, { 0xcf42894a5dce35ea, -1140 },
+	{ 0x9a6bb0aa55653b2d, -1113 }, { 0xe61acf033d1a45df, -1087 },
+	{ 0xab70fe17c79ac6ca, -1060 }, { 0xff77b1fcbebcdc4f, -1034 },
+	{ 0xbe5691ef416bd60c, -1007 }, { 0x8dd01fad907ffc3c, -980 },
+	{ 0xd3515c2831559a83, -954 }, { 0x9d71ac8fada6c9b5, -927 },
+	{ 0xea9c227723ee8bcb, -901 }, { 0xaecc49914078536d, -874 },
+	{ 0x823c12795db6ce57, -847 }, { 0xc21094364dfb5637, -821 },
+	{ 0x9096ea6f3848984f, -794 }, { 0xd77485cb25823ac7, -768 },
+	{ 0xa086cfcd97bf97f4, -741 }, { 0xef340a98172aace5, -715 },
+	{ 0xb23867fb2a35b28e, -688 }, { 0x84c8d4dfd2c63f3b, -661 },
+	{ 0xc5dd44271ad3cdba, -635 }, { 0x936b9fcebb25c996, -608 },
+	{ 0xdbac6c247d62a584, -582 }, { 0xa3ab66580d5fdaf6, -555 },
+	{ 0xf3e2f893dec3f126, -529 }, { 0xb5b5ada8aaff80b8, -502 },
+	{ 0x87625f056c7c4a8b, -475 }, { 0xc9bcff6034c13053, -449 },
+	{ 0x964e858c91ba2655, -422 }, { 0xdff9772470297ebd, -396 },
+	{ 0xa6dfbd9fb8e5b88f, -369 }, { 0xf8a95fcf88747d94, -343 },
+	{ 0xb94470938fa89bcf, -316 }, { 0x8a08f0f8bf0f156b, -289 },
+	{ 0xcdb02555653131b6, -263 }, { 0x993fe2c6d07b7fac, -236 },
+	{ 0xe45c10c42a2b3b06, -210 }, { 0xaa242499697392d3, -183 },
+	{ 0xfd87b5f28300ca0e, -157 }, { 0xbce5086492111aeb, -130 },
+	{ 0x8cbccc096f5088cc, -103 }, { 0xd1b71758e219652c, -77 },
+	{ 0x9c40000000000000, -50 }, { 0xe8d4a51000000000, -24 },
+	{ 0xad78ebc5ac620000, 3 }, { 0x813f3978f8940984, 30 },
+	{ 0xc097ce7bc90715b3, 56 }, { 0x8f7e32ce7bea5c70, 83 },
+	{ 0xd5d238a4abe98068, 109 }, { 0x9f4f2726179a2245, 136 },
+	{ 0xed63a231d4c4fb27, 162 }, { 0xb0de65388cc8ada8, 189 },
+	{ 0x83c7088e1aab65db, 216 }, { 0xc45d1df942711d9a, 242 },
+	{ 0x924d692ca61be758, 269 }, { 0xda01ee641a708dea, 295 },
+	{ 0xa26da3999aef774a, 322 }, { 0xf209787bb47d6b85, 348 },
+	{ 0xb454e4a179dd1877, 375 }, { 0x865b86925b9bc5c2, 402 },
+	{ 0xc83553c5c8965d3d, 428 }, { 0x952ab45cfa97a0b3, 455 },
+	{ 0xde469fbd99a05fe3, 481 }, { 0xa59bc234db398c25, 508 },
+	{ 0xf6c69a72a3989f5c, 534 }, { 0xb7dcbf5354e9bece, 561 },
+	{ 0x88fcf317f22241e2, 588 }, { 0xcc20ce9bd35c78a5, 614 },
+	{ 0x98165af37b2153df, 641 }, { 0xe2a0b5dc971f303a, 667 },
+	{ 0xa8d9d1535ce3b396, 694 }, { 0xfb9b7cd9a4a7443c, 720 },
+	{ 0xbb764c4ca7a44410, 747 }, { 0x8bab8eefb6409c1a, 774 },
+	{ 0xd01fef10a657842c, 800 }, { 0x9b10a4e5e9913129, 827 },
+	{ 0xe7109bfba19c0c9d, 853 }, { 0xac2820d9623bf429, 880 },
+	{ 0x80444b5e7aa7cf85, 907 }, { 0xbf21e44003acdd2d, 933 },
+	{ 0x8e679c2f5e44ff8f, 960 }, { 0xd433179d9c8cb841, 986 },
+	{ 0x9e19db92b4e31ba9, 1013 }, { 0xeb96bf6ebadf77d9, 1039 },
+	{ 0xaf87023b9bf0ee6b, 1066 },
+};
+
+static struct fp unpack(double x)
+{
+	union { double f; uint64_t i; } u = { x };
+	struct fp r = { u.i & -1ULL>>12, u.i>>52 };
+	if (r.e) r.f |= 1ULL<<52, r.e -= 1075;
+	else r.e = -1074;
+	return r;
+}
+
+static struct fp norm(struct fp x)
+{
+	int s = a_clz_64(x.f);
+	x.f <<= s;
+	x.e -= s;
+	return x;
+}
+
+static struct fp mul(struct fp x, struct fp y)
+{
+	uint64_t a = x.f>>32, b = x.f&0xffffffff;
+	uint64_t c = y.f>>32, d = y.f&0xffffffff;
+	uint64_t ad = a*d, bc = b*c;
+	uint64_t t = (b*d>>32) + (ad&0xffffffff) + (bc&0xffffffff) + (1U<<31);
+	return (struct fp){ a*c + (ad>>32) + (bc>>32) + (t>>32), x.e+y.e+64 };
+}
+
+/* Scale a normalized w by 10^*k so that the binary exponent of the
+ * product is between -60 and -32. */
+static struct fp scale(struct fp w, int *k)
+{
+	int min = -60-64-w.e, i = ((min+1220)*1000 + 26574) / 26575;
+	while (pow10[i].e < min) i++;
+	while (i && pow10[i-1].e >= min) i--;
+	*k = -348 + 8*i;
+	return mul(w, pow10[i]);
+}
+
+/* Number of decimal digits in x > 0, and the largest power of ten
+ * not exceeding it. */
+static int ilog10(uint32_t x, uint32_t *p)
+{
+	int n;
+	for (n=1, *p=1; n<10 && x >= *p*10; n++, *p*=10);
+	return n;
+}
+
+/* The digits in buf represent w+rest, in units of ten_kappa for the
+ * last digit, with w off by up to unit. Round to nearest if that gives
+ * the same result throughout the error interval. */
+static int round_counted(char *buf, int len, uint64_t rest,
+	uint64_t ten_kappa, uint64_t unit, int *e)
+{
+	int i;
+	if (unit >= ten_kappa || ten_kappa - unit <= unit) return 0;
+	if (ten_kappa - rest > rest && ten_kappa - 2*rest >= 2*unit)
+		return len;
+	if (rest > unit && ten_kappa - (rest-unit) <= rest-unit) {
+		for (i=len-1; i && buf[i]=='9'; i--) buf[i] = '0';
+		if (buf[i]++ == '9') {
+			buf[0] = '1';
+			++*e;
+		}
+		return len;
+	}
+	return 0;
+}
+
+/* Round x to n significant digits, or if n is 0, to the digit for
+ * 10^lo. At most 17 digits are produced. Returns the number of digits
+ * and stores the decimal exponent of the first in *e. */
+int __fp_digits(double x, char *buf, int n, int lo, int *e)
+{
+	struct fp w;
+	uint64_t one, frac, unit = 1;
+	uint32_t ip, p10;
+	int k, kappa, len = 0;
+
+	w = scale(norm(unpack(x)), &k);
+	one = 1ULL << -w.e;
+	ip = w.f >> -w.e;
+	frac = w.f & one-1;
+	kappa = ilog10(ip, &p10);
+
+	*e = kappa-1 - k;
+	if (!n) {
+		if (lo > *e || lo < *e-16) return 0;
+		n = *e - lo + 1;
+	}
+	if (n > 17) return 0;
+
+	for (; kappa > 0; kappa--, p10 /= 10) {
+		buf[len++] = '0' + ip/p10;
+		ip %= p10;
+		if (len == n) return round_counted(buf, len,
+			((uint64_t)ip << -w.e) + frac,
+			(uint64_t)p10 << -w.e, unit, e);
+	}
+	while (len < n && frac > unit) {
+		frac *= 10;
+		unit *= 10;
+		buf[len++] = '0' + (frac >> -w.e);
+		frac &= one-1;
+	}
+	if (len < n) return 0;
+	return round_counted(buf, len, frac, one, unit, e);
+}
+
+/* The digits in buf represent too_high-rest, where too_high is dist
+ * above w and the value to be represented is within unit of w. Move
+ * the last digit toward w while that stays inside the interval delta
+ * below too_high, and succeed if the result is certain to be both
+ * inside the rounding interval and the closest candidate to w. */
+static int weed(char *buf, int len, uint64_t dist, uint64_t delta,
+	uint64_t rest, uint64_t ten_kappa, uint64_t unit)
+{
+	uint64_t small = dist - unit, big = dist + unit;
+	while (rest < small && delta - rest >= ten_kappa
+	       && (rest + ten_kappa < small
+	           || small - rest >= rest + ten_kappa - small)) {
+		buf[len-1]--;
+		rest += ten_kappa;
+	}
+	if (rest < big && delta - rest >= ten_kappa
+	    && (rest + ten_kappa < big
+	        || big - rest > rest + ten_kappa - big))
+		return 0;
+	return 2*unit <= rest && rest <= delta - 4*unit;
+}
+
+/* Shortest digits that read back as x. Returns their number (at most
+ * 17) and stores the decimal exponent of the first in *e. */
+int __fp_shortest(double x, char *buf, int *e)
+{
+	struct fp v = unpack(x), w, lo, hi;
+	uint64_t one, frac, rest, delta, unit = 1;
+	uint32_t ip, p10;
+	int k, kappa, len = 0;
+
+	/* Boundaries halfway to the neighbouring doubles; the one below
+	 * is closer at powers of two. */
+	hi = norm((struct fp){ 2*v.f+1, v.e-1 });
+	if (v.f == 1ULL<<52 && v.e > -1074)
+		lo = (struct fp){ 4*v.f-1, v.e-2 };
+	else
+		lo = (struct fp){ 2*v.f-1, v.e-1 };
+	lo.f <<= lo.e - hi.e;
+	lo.e = hi.e;
+
+	w = scale(norm(v), &k);
+	hi = mul(hi, pow10[(k+348)/8]);
+	lo = mul(lo, pow10[(k+348)/8]);
+
+	/* Widen by the error to an interval that surely contains it. */
+	hi.f++;
+	lo.f--;
+	delta = hi.f - lo.f;
+	one = 1ULL << -w.e;
+	ip = hi.f >> -w.e;
+	frac = hi.f & one-1;
+	kappa = ilog10(ip, &p10);
+
+	for (; kappa > 0; p10 /= 10) {
+		buf[len++] = '0' + ip/p10;
+		ip %= p10;
+		kappa--;
+		rest = ((uint64_t)ip << -w.e) + frac;
+		if (rest < delta) {
+			if (!weed(buf, len, hi.f - w.f, delta, rest,
+			          (uint64_t)p10 << -w.e, unit)) return 0;
+			goto done;
+		}
+	}
+	for (;;) {
+		frac *= 10;
+		unit *= 10;
+		delta *= 10;
+		buf[len++] = '0' + (frac >> -w.e);
+		frac &= one-1;
+		kappa--;
+		if (frac < delta) {
+			if (!weed(buf, len, (hi.f - w.f)*unit, delta, frac,
+			          one, unit)) return 0;
+			break;
+		}
+		if (len == 17) return 0;
+	}
+done:
+	*e = kappa - k + len-1;
+	return len;
+}
@@ -0,0 +1,7 @@
+#ifndef FPDIGITS_H
+#define FPDIGITS_H
+
+int __fp_digits(double, char *, int, int, int *);
+int __fp_shortest(double, char *, int *);
+
+#endif
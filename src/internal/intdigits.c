@@ -0,0 +1,31 @@
+#include <limits.h>
+#include "intdigits.h"
+
+/* Decimal digits are produced two at a time from a table of the
+ * pairs 00 to 99, halving the number of divisions. */
+
+static const char pairs[200] =
+	"00010203040506070809" "10111213141516171819"
+	"20212223242526272829" "30313233343536373839"
+	"40414243444546474849" "50515253545556575859"
+	"60616263646566676869" "70717273747576777879"
+	"80818283848586878889" "90919293949596979899";
+
+static char *pair(char *s, unsigned r)
+{
+	s[-2] = pairs[2*r];
+	s[-1] = pairs[2*r+1];
+	return s-2;
+}
+
+/* Write the digits of x so that they end just before s and return a
+ * pointer to the first one; nothing is written for 0. */
+char *__fmt_u(uintmax_t x, char *s)
+{
+	unsigned long y;
+	for (; x>ULONG_MAX; x/=100) s = pair(s, x%100);
+	for (y=x; y>=100; y/=100) s = pair(s, y%100);
+	if (y>=10) s = pair(s, y);
+	else if (y) *--s = '0'+y;
+	return s;
+}
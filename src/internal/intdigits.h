@@ -0,0 +1,8 @@
+#ifndef INTDIGITS_H
+#define INTDIGITS_H
+
+#include <stdint.h>
+
+char *__fmt_u(uintmax_t, char *);
+
+#endif
@@ -46,11 +46,14 @@ extern size_t __hwcap ATTR_LIBC_VISIBILITY;
 extern size_t __sysinfo ATTR_LIBC_VISIBILITY;
 extern char *__progname, *__progname_full;
 
+void __init_cpu(void) ATTR_LIBC_VISIBILITY;
+
 /* Designed to avoid any overhead in non-threaded processes */
 void __lock(volatile int *) ATTR_LIBC_VISIBILITY;
 void __unlock(volatile int *) ATTR_LIBC_VISIBILITY;
 int __lockfile(FILE *) ATTR_LIBC_VISIBILITY;
 void __unlockfile(FILE *) ATTR_LIBC_VISIBILITY;
+int __unbiasfile(FILE *, int) ATTR_LIBC_VISIBILITY;
 #define LOCK(x) __lock(x)
 #define UNLOCK(x) __unlock(x)
 
@@ -21,10 +21,16 @@ struct bin {
 #define SIZE_MASK (-SIZE_ALIGN)
 #define OVERHEAD (2*sizeof(size_t))
 #define MMAP_THRESHOLD (0x1c00*SIZE_ALIGN)
+#define MMAP_THRESHOLD_MAX ((4<<20)*sizeof(long))
+#define TRIM_THRESHOLD (2*MMAP_THRESHOLD)
 #define DONTCARE 16
 #define RECLAIM 163840
+#define SLAB_MAX ((128 + OVERHEAD + SIZE_ALIGN - 1) & SIZE_MASK)
+#define SLAB_RUN 4096
+#define PURGE_DECAY 10000
+#define HUGE_PAGE ((size_t)2<<20)
 
-#define CHUNK_SIZE(c) ((c)->csize & -2)
+#define CHUNK_SIZE(c) ((c)->csize & -8)
 #define CHUNK_PSIZE(c) ((c)->psize & -2)
 #define PREV_CHUNK(c) ((struct chunk *)((char *)(c) - CHUNK_PSIZE(c)))
 #define NEXT_CHUNK(c) ((struct chunk *)((char *)(c) + CHUNK_SIZE(c)))
@@ -33,13 +39,59 @@ struct bin {
 #define BIN_TO_CHUNK(i) (MEM_TO_CHUNK(&mal.bins[i].head))
 
 #define C_INUSE  ((size_t)1)
+#define C_SLAB   ((size_t)2)
+#define C_ARENA  ((size_t)4)
 
 #define IS_MMAPPED(c) !((c)->csize & (C_INUSE))
+#define IS_SLAB(c) ((c)->csize & C_SLAB)
+#define IS_ARENA(c) ((c)->csize & C_ARENA)
+
+struct heap_stats {
+	size_t heap;
+	size_t mmap_cnt, mmap_size;
+	size_t maps, unmaps;
+	size_t slab_cnt, slab_size;
+	size_t cache_cnt, cache_size;
+	size_t top;
+	struct {
+		size_t cnt, size, dirty;
+		unsigned contended;
+	} bin[64];
+};
 
 __attribute__((__visibility__("hidden")))
 void __bin_chunk(struct chunk *);
 
+__attribute__((__visibility__("hidden")))
+void __malloc_heap_stats(struct heap_stats *);
+
+__attribute__((__visibility__("hidden")))
+void __malloc_cache_stats(struct heap_stats *);
+
 __attribute__((__visibility__("hidden")))
 extern int __malloc_replaced;
 
+__attribute__((__visibility__("hidden")))
+extern int __malloc_hugepage;
+
+__attribute__((__visibility__("hidden")))
+void *__map_huge(size_t);
+
+#define PROF_RING 4096
+
+__attribute__((__visibility__("hidden")))
+extern struct malloc_sample *volatile __malloc_prof_ring;
+
+__attribute__((__visibility__("hidden")))
+extern volatile int __malloc_prof_head;
+
+__attribute__((__visibility__("hidden")))
+void *__malloc_heap(size_t);
+
+__attribute__((__visibility__("hidden")))
+extern int __malloc_arena_used;
+
+__attribute__((__visibility__("hidden")))
+void *__malloc_arena_chunk(size_t);
+
 #endif
@@ -12,6 +12,8 @@
 
 #define pthread __pthread
 
+#define MALLOC_CACHE_BINS 16
+
 struct pthread {
 	/* Part 1 -- these fields may be external or
 	 * internal (accessed via asm) ABI. Do not change. */
@@ -49,6 +51,14 @@ struct pthread {
 	volatile int killlock[1];
 	char *dlerror_buf;
 	void *stdio_locks;
+	struct {
+		void *head;
+		size_t count;
+	} malloc_cache[MALLOC_CACHE_BINS];
+	void *malloc_arena;
+	size_t malloc_sample;
+	uint64_t malloc_seed;
+	void *printf_cache;
 
 	/* Part 3 -- the positions of these fields relative to
 	 * the end of the structure is external and internal ABI. */
@@ -18,6 +18,7 @@
 #define F_ERR 32
 #define F_SVB 64
 #define F_APP 128
+#define F_ASYNC 256
 
 struct _IO_FILE {
 	unsigned flags;
@@ -48,6 +49,7 @@ struct _IO_FILE {
 	off_t shlim, shcnt;
 	FILE *prev_locked, *next_locked;
 	struct __locale_struct *locale;
+	volatile int bias, bias_held, bias_revoke;
 };
 
 size_t __stdio_read(FILE *, unsigned char *, size_t);
@@ -58,6 +60,9 @@ int __stdio_close(FILE *);
 
 size_t __string_read(FILE *, unsigned char *, size_t);
 
+void __stdio_mmap(FILE *);
+void __stdio_munmap(FILE *);
+
 int __toread(FILE *);
 int __towrite(FILE *);
 
@@ -90,6 +95,14 @@ void __ofl_unlock(void);
 	( ((unsigned char)(c)!=(f)->lbf && (f)->wpos<(f)->wend) \
 	? *(f)->wpos++ = (c) : __overflow((f),(c)) )
 
+struct __printf_plan;
+size_t __printf_plan_size(const char *) ATTR_LIBC_VISIBILITY;
+int __printf_compile(struct __printf_plan *, const char *) ATTR_LIBC_VISIBILITY;
+int __printf_plan_match(const struct __printf_plan *, const char *) ATTR_LIBC_VISIBILITY;
+extern volatile int __printf_cache_slots ATTR_LIBC_VISIBILITY;
+struct __printf_plan *__printf_cache_get(const char *) ATTR_LIBC_VISIBILITY;
+void __printf_cache_put(const char *, struct __printf_plan *) ATTR_LIBC_VISIBILITY;
+
 /* Caller-allocated FILE * operations */
 FILE *__fopen_rb_ca(const char *, FILE *, unsigned char *, size_t);
 int __fclose_ca(FILE *);
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include "libc.h"
+#include "pthread_impl.h"
+#include "malloc_impl.h"
+
+/* Arenas are chains of blocks mapped directly from the kernel. The
+ * arena itself lives at the start of the first block. Allocation bumps
+ * a pointer through the current block; reset rewinds to the first
+ * block, keeping all blocks for reuse, and destroy unmaps them. */
+
+struct block {
+	struct block *next;
+	size_t size;
+};
+
+struct __malloc_arena {
+	struct block *head, *cur;
+	char *pos, *end;
+};
+
+#define ALIGN 16
+#define BLOCK_MIN 65536
+#define BLOCK_MAX ((size_t)64<<20)
+#define HDR_SIZE ((sizeof(struct block) + ALIGN-1) & -ALIGN)
+#define ARENA_SIZE ((sizeof(struct __malloc_arena) + ALIGN-1) & -ALIGN)
+
+int __malloc_arena_used;
+
+static struct block *map_block(size_t n)
+{
+	struct block *b;
+	n = n + PAGE_SIZE-1 & -PAGE_SIZE;
+	b = __mmap(0, n, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (b == MAP_FAILED) return 0;
+	b->next = 0;
+	b->size = n;
+	return b;
+}
+
+static void enter(malloc_arena_t *a, struct block *b)
+{
+	a->cur = b;
+	a->pos = (char *)b + (b == a->head ? HDR_SIZE + ARENA_SIZE : HDR_SIZE);
+	a->end = (char *)b + b->size;
+}
+
+malloc_arena_t *malloc_arena_create(size_t n)
+{
+	struct block *b;
+	malloc_arena_t *a;
+
+	if (n > SIZE_MAX/2) {
+		errno = ENOMEM;
+		return 0;
+	}
+	n += HDR_SIZE + ARENA_SIZE;
+	if (!(b = map_block(n < BLOCK_MIN ? BLOCK_MIN : n))) return 0;
+	a = (void *)((char *)b + HDR_SIZE);
+	a->head = b;
+	enter(a, b);
+	return a;
+}
+
+void *malloc_arena_alloc_aligned(malloc_arena_t *a, size_t align, size_t n)
+{
+	struct block *b;
+	uintptr_t p;
+	size_t len;
+
+	if ((align & -align) != align) {
+		errno = EINVAL;
+		return 0;
+	}
+	if (align < ALIGN) align = ALIGN;
+	if (n > SIZE_MAX/2 - align) {
+		errno = ENOMEM;
+		return 0;
+	}
+
+	p = (uintptr_t)a->pos + align-1 & -align;
+	if (p > (uintptr_t)a->end || n > (uintptr_t)a->end - p) {
+		/* Move on to the next kept block that fits, or map a new
+		 * one after the current block, growing geometrically. */
+		for (b=a->cur->next; b; b=b->next)
+			if (n + align-1 <= b->size - HDR_SIZE) break;
+		if (!b) {
+			len = a->cur->size < BLOCK_MAX ? 2*a->cur->size : BLOCK_MAX;
+			if (len < n + align-1 + HDR_SIZE)
+				len = n + align-1 + HDR_SIZE;
+			if (!(b = map_block(len))) return 0;
+			b->next = a->cur->next;
+			a->cur->next = b;
+		}
+		enter(a, b);
+		p = (uintptr_t)a->pos + align-1 & -align;
+	}
+	a->pos = (char *)p + n;
+	return (void *)p;
+}
+
+void *malloc_arena_alloc(malloc_arena_t *a, size_t n)
+{
+	return malloc_arena_alloc_aligned(a, ALIGN, n);
+}
+
+void malloc_arena_reset(malloc_arena_t *a)
+{
+	enter(a, a->head);
+}
+
+void malloc_arena_destroy(malloc_arena_t *a)
+{
+	struct block *b, *next;
+	if (!a) return;
+	if (__pthread_self()->malloc_arena == a)
+		__pthread_self()->malloc_arena = 0;
+	for (b=a->head; b; b=next) {
+		next = b->next;
+		__munmap(b, b->size);
+	}
+}
+
+malloc_arena_t *malloc_arena_select(malloc_arena_t *a)
+{
+	pthread_t self = __pthread_self();
+	malloc_arena_t *old = self->malloc_arena;
+	if (a) __malloc_arena_used = 1;
+	self->malloc_arena = a;
+	return old;
+}
+
+/* Called by malloc, with n already adjusted to a chunk size, when the
+ * calling thread has selected an arena. The chunk header lets free,
+ * realloc and malloc_usable_size recognize the result. The header is
+ * placed just below an aligned address so that the memory returned is
+ * SIZE_ALIGN-aligned like any other chunk, as memalign assumes. */
+void *__malloc_arena_chunk(size_t n)
+{
+	struct chunk *c;
+	char *p = malloc_arena_alloc_aligned(__pthread_self()->malloc_arena,
+		SIZE_ALIGN, n + SIZE_ALIGN-OVERHEAD);
+	if (!p) return 0;
+	c = (void *)(p + SIZE_ALIGN-OVERHEAD);
+	c->psize = 0;
+	c->csize = n | C_INUSE | C_ARENA;
+	return CHUNK_TO_MEM(c);
+}
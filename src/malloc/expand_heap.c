@@ -1,9 +1,11 @@
+#define _GNU_SOURCE
 #include <limits.h>
 #include <stdint.h>
 #include <errno.h>
 #include <sys/mman.h>
 #include "libc.h"
 #include "syscall.h"
+#include "malloc_impl.h"
 
 /* This function returns true if the interval [old,new]
  * intersects the 'len'-sized interval below &libc.auxv
@@ -27,7 +29,28 @@ static int traverses_stack_p(uintptr_t old, uintptr_t new)
 	return 0;
 }
 
-void *__mmap(void *, size_t, int, int, int, off_t);
+int __malloc_hugepage;
+
+/* Map n bytes, which must be a multiple of the page size, at an
+ * address aligned to HUGE_PAGE, and ask the kernel to back them
+ * with transparent huge pages. The excess mapped for alignment is
+ * unmapped again. */
+
+void *__map_huge(size_t n)
+{
+	size_t extra = HUGE_PAGE - PAGE_SIZE;
+	char *p, *a;
+
+	if (n > SIZE_MAX - extra) return MAP_FAILED;
+	p = __mmap(0, n + extra, PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) return p;
+	a = (char *)((uintptr_t)p + HUGE_PAGE-1 & -HUGE_PAGE);
+	if (a > p) __munmap(p, a-p);
+	if (a+n < p+n+extra) __munmap(a+n, p+extra-a);
+	__madvise(a, n, MADV_HUGEPAGE);
+	return a;
+}
 
 /* Expand the heap in-place if brk can be used, or otherwise via mmap,
  * using an exponential lower bound on growth by mmap to make
@@ -35,7 +58,9 @@ void *__mmap(void *, size_t, int, int, int, off_t);
  * an input and an output, since the caller needs to know the size
  * allocated, which will be larger than requested due to page alignment
  * and mmap minimum size rules. The caller is responsible for locking
- * to prevent concurrent calls. */
+ * to prevent concurrent calls. When huge pages are enabled, the brk
+ * heap is grown to HUGE_PAGE boundaries and mmap growth is in aligned
+ * multiples of HUGE_PAGE, both marked for transparent huge pages. */
 
 void *__expand_heap(size_t *pn)
 {
@@ -54,17 +79,28 @@ void *__expand_heap(size_t *pn)
 		brk += -brk & PAGE_SIZE-1;
 	}
 
-	if (n < SIZE_MAX-brk && !traverses_stack_p(brk, brk+n)
-	    && __syscall(SYS_brk, brk+n)==brk+n) {
-		*pn = n;
-		brk += n;
-		return (void *)(brk-n);
+	size_t m = n;
+	if (__malloc_hugepage) m += -(brk+n) & HUGE_PAGE-1;
+
+	if (m < SIZE_MAX-brk && !traverses_stack_p(brk, brk+m)
+	    && __syscall(SYS_brk, brk+m)==brk+m) {
+		if (__malloc_hugepage)
+			__madvise((void *)brk, m, MADV_HUGEPAGE);
+		*pn = m;
+		brk += m;
+		return (void *)(brk-m);
 	}
 
 	size_t min = (size_t)PAGE_SIZE << mmap_step/2;
 	if (n < min) n = min;
-	void *area = __mmap(0, n, PROT_READ|PROT_WRITE,
-		MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	void *area;
+	if (__malloc_hugepage) {
+		n += -n & HUGE_PAGE-1;
+		area = __map_huge(n);
+	} else {
+		area = __mmap(0, n, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	}
 	if (area == MAP_FAILED) return 0;
 	*pn = n;
 	mmap_step++;
@@ -0,0 +1,42 @@
+#include <malloc.h>
+#include "libc.h"
+#include "malloc_impl.h"
+
+struct mallinfo2 mallinfo2(void)
+{
+	struct heap_stats st;
+	struct mallinfo2 mi = { 0 };
+	int i;
+
+	__malloc_heap_stats(&st);
+	__malloc_cache_stats(&st);
+	for (i=0; i<64; i++) {
+		mi.ordblks += st.bin[i].cnt;
+		mi.fordblks += st.bin[i].size;
+	}
+	mi.arena = st.heap;
+	mi.smblks = st.slab_cnt + st.cache_cnt;
+	mi.fsmblks = st.slab_size + st.cache_size;
+	mi.hblks = st.mmap_cnt;
+	mi.hblkhd = st.mmap_size;
+	mi.uordblks = st.heap - mi.fordblks - mi.fsmblks;
+	mi.keepcost = st.top;
+	return mi;
+}
+
+struct mallinfo mallinfo(void)
+{
+	struct mallinfo2 mi = mallinfo2();
+	return (struct mallinfo){
+		.arena = mi.arena,
+		.ordblks = mi.ordblks,
+		.smblks = mi.smblks,
+		.hblks = mi.hblks,
+		.hblkhd = mi.hblkhd,
+		.usmblks = mi.usmblks,
+		.fsmblks = mi.fsmblks,
+		.uordblks = mi.uordblks,
+		.fordblks = mi.fordblks,
+		.keepcost = mi.keepcost,
+	};
+}
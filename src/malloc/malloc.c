@@ -4,7 +4,11 @@
 #include <limits.h>
 #include <stdint.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <malloc.h>
 #include "libc.h"
 #include "atomic.h"
 #include "pthread_impl.h"
@@ -14,20 +18,147 @@
 #define inline inline __attribute__((always_inline))
 #endif
 
+struct slab {
+	struct slab *next, *prev;
+	size_t size;
+	unsigned short cnt, avail;
+	uint64_t map[SLAB_RUN/SIZE_ALIGN/64];
+};
+
+#define SLAB_BINS (SLAB_MAX/SIZE_ALIGN)
+#define SLAB_HDR ((OVERHEAD + sizeof(struct slab) + SIZE_ALIGN-1) & SIZE_MASK)
+
 static struct {
 	volatile uint64_t binmap;
 	struct bin bins[64];
 	volatile int free_lock[2];
+	struct {
+		volatile int lock[2];
+		struct slab *head;
+	} slabs[SLAB_BINS];
+	size_t dirty[64];
+	volatile int purge_lock[2];
+	volatile int purge_pending, purge_missed, purge_ticks;
+	size_t purge_oldest;
+	unsigned contended[64];
+	size_t heap_size;
+	uintptr_t top_dirty;
+	volatile int tune_lock[2];
+	volatile int mmap_cnt, mmap_pages, maps, unmaps;
 } mal;
 
+static volatile int purge_decay = PURGE_DECAY;
+static volatile size_t mmap_threshold = MMAP_THRESHOLD;
+static volatile size_t trim_threshold = TRIM_THRESHOLD;
+static volatile size_t top_pad;
+static volatile int tuned;
+
 int __malloc_replaced;
 
+/* arena.c overrides these */
+static int dummy_arena_used;
+weak_alias(dummy_arena_used, __malloc_arena_used);
+static void *dummy_arena_chunk(size_t n)
+{
+	return 0;
+}
+weak_alias(dummy_arena_chunk, __malloc_arena_chunk);
+
+int __clock_gettime(clockid_t, struct timespec *);
+
+/* Sampling profiler */
+
+static size_t prof_rate;
+static size_t prof_main_stack;
+struct malloc_sample *volatile __malloc_prof_ring;
+volatile int __malloc_prof_head;
+
+/* Draw the number of bytes until the next sample from an exponential
+ * distribution with mean prof_rate, so that sampling is a Poisson
+ * process over allocated bytes. log2 of the uniform variate is
+ * approximated piecewise linearly, which is plenty for sampling. */
+static size_t prof_interval(pthread_t self)
+{
+	uint64_t r;
+	int e;
+
+	if (!self->malloc_seed) self->malloc_seed = (uintptr_t)self;
+	self->malloc_seed = 6364136223846793005ULL*self->malloc_seed + 1;
+	r = self->malloc_seed >> 11 | 1;
+	e = 63 - a_clz_64(r);
+	return (53 - e - (double)(r - (1ULL<<e)) / (1ULL<<e))
+		* 0.6931471805599453 * prof_rate + 1;
+}
+
+static void __attribute__((__noinline__)) prof_sample(size_t n, void *caller)
+{
+	pthread_t self = __pthread_self();
+	struct malloc_sample *s;
+	int first = !self->malloc_seed;
+	unsigned seq;
+	size_t d = 0;
+
+	self->malloc_sample = prof_interval(self);
+	if (first) return;
+
+	/* Sequence numbers count modulo 2^32; 0 marks a slot being
+	 * written, so the one sample that would get it is dropped. */
+	seq = a_fetch_add(&__malloc_prof_head, 1) + 1U;
+	if (!seq) return;
+	s = __malloc_prof_ring + seq % PROF_RING;
+	s->seq = 0;
+	a_barrier();
+	s->size = n;
+	s->caller = caller;
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+	/* Walk frame records of {saved frame pointer, return address},
+	 * accepting only frame pointers that strictly ascend, since libc
+	 * and application code may have been built without frame
+	 * pointers. Everything between the current frame and the top of
+	 * the thread's stack is mapped, so records there are read
+	 * directly. Beyond it, or when running on a signal, makecontext
+	 * or coroutine stack whose extent is unknown, they are read with
+	 * process_vm_readv, which fails instead of faulting. */
+	void **fp = __builtin_frame_address(0), **next, *rec[2];
+	struct iovec local = { rec, sizeof rec }, remote = { 0, sizeof rec };
+	uintptr_t top = (uintptr_t)self->stack;
+	size_t size = self->stack_size;
+	if (!top) {
+		top = (uintptr_t)libc.auxv;
+		size = prof_main_stack;
+	}
+	if (top - (uintptr_t)fp > size) top = 0;
+	for (next=fp[0]; d<MALLOC_SAMPLE_DEPTH; d++) {
+		if ((char *)next <= (char *)fp || (uintptr_t)next % sizeof *fp)
+			break;
+		fp = next;
+		if (top && (uintptr_t)(fp+2) <= top) {
+			next = fp[0];
+			s->stack[d] = fp[1];
+			continue;
+		}
+		remote.iov_base = fp;
+		if (__syscall(SYS_process_vm_readv, self->tid,
+		    &local, 1, &remote, 1, 0) != sizeof rec) break;
+		next = rec[0];
+		s->stack[d] = rec[1];
+	}
+#endif
+	s->depth = d;
+	a_barrier();
+	s->seq = seq;
+}
+
 /* Synchronization tools */
 
-static inline void lock(volatile int *lk)
+static inline int lock(volatile int *lk)
 {
-	if (libc.threads_minus_1)
-		while(a_swap(lk, 1)) __wait(lk, lk+1, 1, 1);
+	if (libc.threads_minus_1 && a_swap(lk, 1)) {
+		do __wait(lk, lk+1, 1, 1);
+		while (a_swap(lk, 1));
+		return 1;
+	}
+	return 0;
 }
 
 static inline void unlock(volatile int *lk)
@@ -40,7 +171,8 @@ static inline void unlock(volatile int *lk)
 
 static inline void lock_bin(int i)
 {
-	lock(mal.bins[i].lock);
+	if (lock(mal.bins[i].lock))
+		mal.contended[i]++;
 	if (!mal.bins[i].head)
 		mal.bins[i].head = mal.bins[i].tail = BIN_TO_CHUNK(i);
 }
@@ -97,6 +229,7 @@ static int bin_index_up(size_t x)
 {
 	x = x / SIZE_ALIGN - 1;
 	if (x <= 32) return x;
+	if (x > 0x1c00) return 63;
 	x--;
 	if (x < 512) return bin_tab[x/8-4] + 1;
 	return bin_tab[x/128-4] + 17;
@@ -134,8 +267,9 @@ static struct chunk *expand_heap(size_t n)
 
 	/* The argument n already accounts for the caller's chunk
 	 * overhead needs, but if the heap can't be extended in-place,
-	 * we need room for an extra zero-sized sentinel chunk. */
-	n += SIZE_ALIGN;
+	 * we need room for an extra zero-sized sentinel chunk. Any
+	 * top pad is left for the caller to trim off into the bins. */
+	n += SIZE_ALIGN + top_pad;
 
 	lock(heap_lock);
 
@@ -144,6 +278,7 @@ static struct chunk *expand_heap(size_t n)
 		unlock(heap_lock);
 		return 0;
 	}
+	mal.heap_size += n;
 
 	/* If not just expanding existing space, we need to make a
 	 * new sentinel chunk below the allocated space. */
@@ -187,8 +322,31 @@ static int adjust_size(size_t *n)
 	return 0;
 }
 
+/* Free chunks spanning whole pages record how many bytes of those
+ * pages are counted in their bin's dirty total, and the time in
+ * milliseconds at which the oldest of them became dirty, in the two
+ * words after the bin links. The pages themselves start above those
+ * words, so purging them never clears them. */
+
+#define CHUNK_DIRTY(c) (((size_t *)(c))[4])
+#define CHUNK_SINCE(c) (((size_t *)(c))[5])
+
+static size_t chunk_pages(struct chunk *c, uintptr_t *a, uintptr_t *b)
+{
+	*a = (uintptr_t)c + SIZE_ALIGN+2*sizeof(size_t)+PAGE_SIZE-1 & -PAGE_SIZE;
+	*b = (uintptr_t)NEXT_CHUNK(c) - SIZE_ALIGN & -PAGE_SIZE;
+	return *b > *a ? *b - *a : 0;
+}
+
+static size_t chunk_dirty(struct chunk *c)
+{
+	uintptr_t a, b;
+	return chunk_pages(c, &a, &b) ? CHUNK_DIRTY(c) : 0;
+}
+
 static void unbin(struct chunk *c, int i)
 {
+	mal.dirty[i] -= chunk_dirty(c);
 	if (c->prev == c->next)
 		a_and_64(&mal.binmap, ~(1ULL<<i));
 	c->prev->next = c->next;
@@ -237,7 +395,8 @@ static int alloc_rev(struct chunk *c)
  * for the _free_ chunk self, and bin j locked. */
 static int pretrim(struct chunk *self, size_t n, int i, int j)
 {
-	size_t n1;
+	size_t n1, d, t;
+	uintptr_t a, b;
 	struct chunk *next, *split;
 
 	/* We cannot pretrim if it would require re-binning. */
@@ -253,6 +412,8 @@ static int pretrim(struct chunk *self, size_t n, int i, int j)
 
 	next = NEXT_CHUNK(self);
 	split = (void *)((char *)self + n);
+	d = chunk_dirty(self);
+	t = CHUNK_SINCE(self);
 
 	split->prev = self->prev;
 	split->next = self->next;
@@ -262,9 +423,31 @@ static int pretrim(struct chunk *self, size_t n, int i, int j)
 	split->csize = n1-n;
 	next->psize = n1-n;
 	self->csize = n | C_INUSE;
+
+	/* The remainder keeps at most the dirty bytes of the whole. */
+	mal.dirty[j] -= d;
+	if (chunk_pages(split, &a, &b)) {
+		if (d > b-a) d = b-a;
+		CHUNK_DIRTY(split) = d;
+		CHUNK_SINCE(split) = t;
+		mal.dirty[j] += d;
+	}
 	return 1;
 }
 
+/* Record that memory up to end is in use. The part of the free chunk
+ * at the end of the heap above the highest such address has not been
+ * touched since it was last trimmed. */
+static void touch(struct chunk *c, size_t n)
+{
+	uintptr_t end = (uintptr_t)c + n;
+	if (end > mal.top_dirty) {
+		lock(mal.free_lock);
+		if (end > mal.top_dirty) mal.top_dirty = end;
+		unlock(mal.free_lock);
+	}
+}
+
 static void trim(struct chunk *self, size_t n)
 {
 	size_t n1 = CHUNK_SIZE(self);
@@ -283,52 +466,340 @@ static void trim(struct chunk *self, size_t n)
 	__bin_chunk(split);
 }
 
-void *malloc(size_t n)
+static struct chunk *grow(size_t n)
+{
+	struct chunk *c = expand_heap(n);
+	if (!c) return 0;
+	if (alloc_rev(c)) {
+		struct chunk *x = c;
+		c = PREV_CHUNK(c);
+		NEXT_CHUNK(x)->psize = c->csize =
+			x->csize + CHUNK_SIZE(c);
+	}
+	return c;
+}
+
+static struct chunk *alloc_chunk(size_t n)
 {
 	struct chunk *c;
 	int i, j;
 
-	if (adjust_size(&n) < 0) return 0;
-
-	if (n > MMAP_THRESHOLD) {
-		size_t len = n + OVERHEAD + PAGE_SIZE - 1 & -PAGE_SIZE;
-		char *base = __mmap(0, len, PROT_READ|PROT_WRITE,
-			MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-		if (base == (void *)-1) return 0;
-		c = (void *)(base + SIZE_ALIGN - OVERHEAD);
-		c->csize = len - (SIZE_ALIGN - OVERHEAD);
-		c->psize = SIZE_ALIGN - OVERHEAD;
-		return CHUNK_TO_MEM(c);
-	}
-
 	i = bin_index_up(n);
 	for (;;) {
 		uint64_t mask = mal.binmap & -(1ULL<<i);
 		if (!mask) {
-			c = expand_heap(n);
+			c = grow(n);
 			if (!c) return 0;
-			if (alloc_rev(c)) {
-				struct chunk *x = c;
-				c = PREV_CHUNK(c);
-				NEXT_CHUNK(x)->psize = c->csize =
-					x->csize + CHUNK_SIZE(c);
-			}
 			break;
 		}
 		j = first_set(mask);
 		lock_bin(j);
 		c = mal.bins[j].head;
+		/* With the mmap threshold raised, the last bin can hold
+		 * chunks smaller than the request. */
+		if (j == 63)
+			while (c != BIN_TO_CHUNK(j) && CHUNK_SIZE(c) < n)
+				c = c->next;
 		if (c != BIN_TO_CHUNK(j)) {
 			if (!pretrim(c, n, i, j)) unbin(c, j);
 			unlock_bin(j);
 			break;
 		}
 		unlock_bin(j);
+		if (j == 63) {
+			c = grow(n);
+			if (!c) return 0;
+			break;
+		}
 	}
 
 	/* Now patch up in case we over-allocated */
+	touch(c, n);
 	trim(c, n);
 
+	return c;
+}
+
+/* carve - allocates cnt chunks of size n by splitting as few large
+ * chunks from the bins as possible. The first chunk of each group
+ * absorbs any slack. Returns the number of chunks stored in c. */
+static size_t carve(size_t n, struct chunk **c, size_t cnt)
+{
+	struct chunk *x;
+	size_t k = 0, m, rest;
+
+	while (k < cnt) {
+		m = cnt - k;
+		if (m > MMAP_THRESHOLD/n) m = MMAP_THRESHOLD/n;
+		if (!m) m = 1;
+		x = alloc_chunk(n*m);
+		if (!x && m > 1) x = alloc_chunk(n*(m=1));
+		if (!x) break;
+		rest = CHUNK_SIZE(x) - (m-1)*n;
+		for (; m; m--, rest=n) {
+			x->csize = rest | C_INUSE;
+			NEXT_CHUNK(x)->psize = x->csize;
+			c[k++] = x;
+			x = NEXT_CHUNK(x);
+		}
+	}
+	return k;
+}
+
+/* Slab allocation of small chunks
+ *
+ * Chunks no larger than SLAB_MAX are slots carved from runs of
+ * SLAB_RUN bytes, themselves ordinary in-use chunks. Each slot keeps
+ * a chunk header whose csize is the slot size with C_INUSE|C_SLAB
+ * set, written once when the run is created, and whose psize is the
+ * offset back to the run. A bitmap in the run header tracks free
+ * slots, so allocation and free never split, merge or rebin. Runs
+ * with free slots are kept on a per-size list; a run that becomes
+ * entirely free is returned to the bins unless it is the last one. */
+
+static struct chunk *slab_run(struct chunk *c)
+{
+	return (void *)((char *)c - c->psize);
+}
+
+static struct slab *slab_new(size_t n)
+{
+	struct chunk *r, *c;
+	struct slab *s;
+	size_t k;
+
+	r = alloc_chunk(SLAB_RUN);
+	if (!r) return 0;
+
+	s = CHUNK_TO_MEM(r);
+	s->next = s->prev = 0;
+	s->size = n;
+	s->cnt = s->avail = (CHUNK_SIZE(r) - SLAB_HDR) / n;
+	memset(s->map, 0, sizeof s->map);
+	for (k=0; k<s->cnt; k++) {
+		s->map[k/64] |= 1ULL << k%64;
+		c = (void *)((char *)r + SLAB_HDR + k*n);
+		c->psize = (char *)c - (char *)r;
+		c->csize = n | C_INUSE | C_SLAB;
+	}
+	return s;
+}
+
+static size_t slab_alloc(size_t n, struct chunk **c, size_t cnt)
+{
+	int i = n / SIZE_ALIGN - 1;
+	struct slab *s;
+	size_t k = 0;
+	int j, w;
+
+	lock(mal.slabs[i].lock);
+	while (k < cnt) {
+		s = mal.slabs[i].head;
+		if (!s) {
+			s = slab_new(n);
+			if (!s) break;
+			mal.slabs[i].head = s;
+		}
+		for (w=0; k<cnt && s->avail; w++) {
+			while (k<cnt && s->map[w]) {
+				j = a_ctz_64(s->map[w]);
+				s->map[w] &= s->map[w]-1;
+				s->avail--;
+				c[k++] = (void *)((char *)MEM_TO_CHUNK(s)
+					+ SLAB_HDR + (w*64+j)*n);
+			}
+		}
+		if (!s->avail) {
+			mal.slabs[i].head = s->next;
+			if (s->next) s->next->prev = 0;
+			s->next = 0;
+		}
+	}
+	unlock(mal.slabs[i].lock);
+	return k;
+}
+
+/* slab_put - returns slot c to its run. Must be called with the
+ * lock for slot size i held. Returns the run if it became empty and
+ * was unlinked, in which case the caller must free it. */
+static struct chunk *slab_put(struct chunk *c, int i)
+{
+	struct chunk *r = slab_run(c);
+	struct slab *s = CHUNK_TO_MEM(r);
+	size_t n = CHUNK_SIZE(c);
+	size_t k = (c->psize - SLAB_HDR) / n;
+
+	/* Crash on corrupted slot header or double free */
+	if (s->size != n || k >= s->cnt || s->map[k/64] & 1ULL<<k%64)
+		a_crash();
+
+	s->map[k/64] |= 1ULL << k%64;
+	if (!s->avail++) {
+		s->prev = 0;
+		s->next = mal.slabs[i].head;
+		if (s->next) s->next->prev = s;
+		mal.slabs[i].head = s;
+	} else if (s->avail == s->cnt && (s->prev || s->next)) {
+		if (s->prev) s->prev->next = s->next;
+		else mal.slabs[i].head = s->next;
+		if (s->next) s->next->prev = s->prev;
+		return r;
+	}
+	return 0;
+}
+
+static void slab_free(struct chunk *c)
+{
+	int i = CHUNK_SIZE(c) / SIZE_ALIGN - 1;
+	struct chunk *r;
+
+	lock(mal.slabs[i].lock);
+	r = slab_put(c, i);
+	unlock(mal.slabs[i].lock);
+
+	if (r) __bin_chunk(r);
+}
+
+/* Per-thread cache of small in-use chunks
+ *
+ * Once the process is multithreaded, chunks no larger than
+ * CACHE_BINS*SIZE_ALIGN are served from and freed to a list of
+ * exact-size chunks in the calling thread's struct pthread. Cached
+ * chunks keep their in-use flags, so neighbors never coalesce with
+ * them, and no lock or atomic is needed to push or pop. A miss
+ * carves CACHE_FILL chunks out of one allocation from the bins, and
+ * a full list returns half its chunks to the bins at once. */
+
+#define CACHE_BINS MALLOC_CACHE_BINS
+#define CACHE_FILL 8
+#define CACHE_MAX 32
+
+#define CACHE_KEY(self, i) ((struct chunk *)&(self)->malloc_cache[i])
+
+static size_t purge_clock(void);
+static void purge_decayed(int, size_t, size_t);
+static void purge_poll(void);
+
+static struct chunk *cache_fill(struct pthread *self, int i, size_t n)
+{
+	struct chunk *list[CACHE_FILL], *x;
+	size_t k;
+
+	if (n <= SLAB_MAX) k = slab_alloc(n, list, CACHE_FILL);
+	else k = carve(n, list, CACHE_FILL);
+	if (!k) return 0;
+
+	/* Keep the first chunk, which holds any slack, for the
+	 * caller and cache the rest. */
+	while (--k) {
+		x = list[k];
+		x->next = self->malloc_cache[i].head;
+		x->prev = CACHE_KEY(self, i);
+		self->malloc_cache[i].head = x;
+		self->malloc_cache[i].count++;
+	}
+	return list[0];
+}
+
+static void cache_drain(struct pthread *self, int i, size_t keep)
+{
+	struct chunk *c;
+	while (self->malloc_cache[i].count > keep) {
+		c = self->malloc_cache[i].head;
+		self->malloc_cache[i].head = c->next;
+		self->malloc_cache[i].count--;
+		if (IS_SLAB(c)) slab_free(c);
+		else __bin_chunk(c);
+	}
+}
+
+static void cache_put(struct pthread *self, struct chunk *c)
+{
+	int i = CHUNK_SIZE(c) / SIZE_ALIGN - 1;
+	struct chunk *x;
+
+	/* Crash on corrupted footer (likely from buffer overflow) */
+	if (!IS_SLAB(c) && NEXT_CHUNK(c)->psize != c->csize) a_crash();
+
+	/* Crash on double free of a chunk already in this cache */
+	if (c->prev == CACHE_KEY(self, i))
+		for (x=self->malloc_cache[i].head; x; x=x->next)
+			if (x == c) a_crash();
+
+	if (self->malloc_cache[i].count >= CACHE_MAX)
+		cache_drain(self, i, CACHE_MAX/2);
+
+	c->next = self->malloc_cache[i].head;
+	c->prev = CACHE_KEY(self, i);
+	self->malloc_cache[i].head = c;
+	self->malloc_cache[i].count++;
+}
+
+void __malloc_cache_flush(void)
+{
+	struct pthread *self = __pthread_self();
+	int i;
+	for (i=0; i<CACHE_BINS; i++)
+		cache_drain(self, i, 0);
+	/* A thread that exits leaves no later allocation of its own to
+	 * return the pages it dirtied once they are due. */
+	if (mal.purge_pending) purge_decayed(0, 0, purge_clock());
+}
+
+void *malloc(size_t n)
+{
+	struct chunk *c;
+
+	if (prof_rate) {
+		pthread_t self = __pthread_self();
+		if (self->malloc_sample > n) self->malloc_sample -= n;
+		else prof_sample(n, __builtin_return_address(0));
+	}
+
+	if (adjust_size(&n) < 0) return 0;
+
+	if (__malloc_arena_used && __pthread_self()->malloc_arena)
+		return __malloc_arena_chunk(n);
+
+	if (n > mmap_threshold) {
+		size_t len = n + OVERHEAD + PAGE_SIZE - 1 & -PAGE_SIZE;
+		char *base = __malloc_hugepage && len >= HUGE_PAGE
+			? __map_huge(len)
+			: __mmap(0, len, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (base == (void *)-1) return 0;
+		a_inc(&mal.maps);
+		a_inc(&mal.mmap_cnt);
+		a_fetch_add(&mal.mmap_pages, len/PAGE_SIZE);
+		c = (void *)(base + SIZE_ALIGN - OVERHEAD);
+		c->csize = len - (SIZE_ALIGN - OVERHEAD);
+		c->psize = SIZE_ALIGN - OVERHEAD;
+		return CHUNK_TO_MEM(c);
+	}
+
+	if (n <= CACHE_BINS*SIZE_ALIGN && libc.threaded) {
+		struct pthread *self = __pthread_self();
+		int i = n / SIZE_ALIGN - 1;
+		if ((c = self->malloc_cache[i].head)) {
+			self->malloc_cache[i].head = c->next;
+			self->malloc_cache[i].count--;
+			c->prev = 0;
+		} else {
+			c = cache_fill(self, i, n);
+			if (!c) return 0;
+			purge_poll();
+		}
+		return CHUNK_TO_MEM(c);
+	}
+
+	if (n <= SLAB_MAX) {
+		if (!slab_alloc(n, &c, 1)) return 0;
+		return CHUNK_TO_MEM(c);
+	}
+
+	c = alloc_chunk(n);
+	if (!c) return 0;
+	purge_poll();
 	return CHUNK_TO_MEM(c);
 }
 
@@ -392,16 +863,38 @@ void *realloc(void *p, size_t n)
 			n0 = n;
 			goto copy_free_ret;
 		}
+		/* Growth reserves half again the requested size, so that
+		 * repeated appends remap a logarithmic number of times, and
+		 * requests that fit within such a reservation are satisfied
+		 * in place. Larger shrinks still give the memory back. The
+		 * kernel tries to extend in place before moving. */
+		size_t reserve = newlen + newlen/2 + PAGE_SIZE-1 & -PAGE_SIZE;
 		newlen = (newlen + PAGE_SIZE-1) & -PAGE_SIZE;
-		if (oldlen == newlen) return p;
-		base = __mremap(base, oldlen, newlen, MREMAP_MAYMOVE);
+		if (newlen <= oldlen && reserve >= oldlen) return p;
+		char *b = newlen > oldlen
+			? __mremap(base, oldlen, reserve, MREMAP_MAYMOVE)
+			: (void *)-1;
+		if (b != (void *)-1) {
+			base = b;
+			newlen = reserve;
+		} else {
+			base = __mremap(base, oldlen, newlen, MREMAP_MAYMOVE);
+		}
 		if (base == (void *)-1)
 			goto copy_realloc;
+		a_fetch_add(&mal.mmap_pages, newlen/PAGE_SIZE - oldlen/PAGE_SIZE);
 		self = (void *)(base + extra);
 		self->csize = newlen - extra;
 		return CHUNK_TO_MEM(self);
 	}
 
+	/* Slots and arena chunks cannot grow in place; keep them
+	 * when shrinking. */
+	if (IS_SLAB(self) || IS_ARENA(self)) {
+		if (n <= n0) return p;
+		goto copy_realloc;
+	}
+
 	next = NEXT_CHUNK(self);
 
 	/* Crash on corrupted footer (likely from buffer overflow) */
@@ -425,6 +918,7 @@ void *realloc(void *p, size_t n)
 	/* If we got enough space, split off the excess and return */
 	if (n <= n1) {
 		//memmove(CHUNK_TO_MEM(self), p, n0-OVERHEAD);
+		touch(self, n);
 		trim(self, n);
 		return CHUNK_TO_MEM(self);
 	}
@@ -439,14 +933,278 @@ copy_free_ret:
 	return new;
 }
 
-void __bin_chunk(struct chunk *self)
+/* Purging of dirty free pages
+ *
+ * Free chunks spanning whole pages add the bytes freed into those
+ * pages to their bin's dirty count, and are stamped with the time the
+ * oldest of them became dirty. Frees that add dirty pages, thread
+ * cache misses and every PURGE_TICKS-th allocation from the bins
+ * while dirty pages are pending check whether the oldest have been
+ * dirty for purge_decay milliseconds. If so, up to PURGE_BATCH chunks
+ * that old are taken out of their bins, their pages handed back to
+ * the kernel with MADV_FREE where supported, and the chunks binned
+ * again clean. Being in use meanwhile, they can be neither allocated
+ * nor merged, so no bin lock is held across madvise. */
+
+#define PURGE_TICKS 32
+#define PURGE_BATCH 16
+
+static size_t purge_clock(void)
+{
+	struct timespec ts;
+	__clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+/* Milliseconds from since to now, or 0 if since was read after now. */
+static size_t purge_age(size_t since, size_t now)
+{
+	return now - since < (size_t)-1/2 ? now - since : 0;
+}
+
+static int purge_chunk(struct chunk *c, size_t keep)
+{
+	static int no_madv_free;
+	uintptr_t a, b, k;
+	if (!chunk_pages(c, &a, &b)) return 0;
+	k = (uintptr_t)CHUNK_TO_MEM(c) + keep + PAGE_SIZE-1 & -PAGE_SIZE;
+	if (k > a) a = k;
+	if (b <= a) return 0;
+	if (!CHUNK_SIZE(NEXT_CHUNK(c))) {
+		lock(mal.free_lock);
+		if (mal.top_dirty > a) mal.top_dirty = a;
+		unlock(mal.free_lock);
+	}
+	if (no_madv_free || __madvise((void *)a, b-a, MADV_FREE)) {
+		no_madv_free = 1;
+		__madvise((void *)a, b-a, MADV_DONTNEED);
+	}
+	return 1;
+}
+
+static void bin_chunk(struct chunk *, int);
+
+/* Purge one batch of chunks dirty for at least age milliseconds at
+ * now, keeping pad bytes at the start of the chunk at the end of the
+ * heap, and set *r if any pages were released. Returns the number of
+ * chunks purged; fewer than PURGE_BATCH means none are left that old.
+ * The caller holds purge_lock. */
+static int purge(size_t now, size_t age, size_t pad, int *r)
+{
+	struct chunk *c, *next, *batch[PURGE_BATCH];
+	size_t t, oldest = 0;
+	int i, k = 0, left = 0;
+
+	for (i=0; i<64 && k<PURGE_BATCH; i++) {
+		if (!mal.dirty[i]) continue;
+		lock_bin(i);
+		for (c=mal.bins[i].head; c!=BIN_TO_CHUNK(i); c=next) {
+			next = c->next;
+			if (!chunk_dirty(c)) continue;
+			t = purge_age(CHUNK_SINCE(c), now);
+			if (t >= age && k < PURGE_BATCH) {
+				unbin(c, i);
+				batch[k++] = c;
+			} else {
+				if (t > oldest) oldest = t;
+				left = 1;
+			}
+		}
+		unlock_bin(i);
+	}
+
+	if (k < PURGE_BATCH) {
+		mal.purge_pending = left;
+		mal.purge_oldest = now - oldest;
+	}
+
+	for (i=0; i<k; i++) {
+		c = batch[i];
+		*r |= purge_chunk(c, CHUNK_SIZE(NEXT_CHUNK(c)) ? 0 : pad);
+		bin_chunk(c, 1);
+	}
+	return k;
+}
+
+/* Record pages dirty since the given time, if dirty is set, and purge
+ * a batch if the oldest pending pages are due. A free that finds
+ * another thread purging leaves its pages to be recorded as dirty
+ * since the next check. */
+static void purge_decayed(int dirty, size_t since, size_t now)
+{
+	int decay = purge_decay;
+
+	if (a_swap(mal.purge_lock, 1)) {
+		if (dirty) mal.purge_missed = 1;
+		return;
+	}
+
+	if (mal.purge_missed) {
+		mal.purge_missed = 0;
+		if (!dirty) since = now;
+		dirty = 1;
+	}
+	if (dirty && (!mal.purge_pending
+	    || purge_age(since, now) > purge_age(mal.purge_oldest, now))) {
+		mal.purge_pending = 1;
+		mal.purge_oldest = since;
+	}
+	if (decay >= 0 && mal.purge_pending
+	    && purge_age(mal.purge_oldest, now) >= decay) {
+		int r = 0;
+		purge(now, decay, 0, &r);
+	}
+
+	unlock(mal.purge_lock);
+}
+
+static void purge_poll(void)
+{
+	if (mal.purge_pending && ++mal.purge_ticks >= PURGE_TICKS) {
+		mal.purge_ticks = 0;
+		purge_decayed(0, 0, purge_clock());
+	}
+}
+
+int malloc_trim(size_t pad)
+{
+	size_t now = purge_clock();
+	int r = 0;
+	lock(mal.purge_lock);
+	while (purge(now, 0, pad, &r) == PURGE_BATCH);
+	unlock(mal.purge_lock);
+	return r;
+}
+
+static int tune(volatile size_t *param, int value)
+{
+	if (value < 0) return 0;
+	lock(mal.tune_lock);
+	*param = value;
+	tuned = 1;
+	unlock(mal.tune_lock);
+	return 1;
+}
+
+int mallopt(int param, int value)
+{
+	switch (param) {
+	case M_MMAP_THRESHOLD:
+		if (value > MMAP_THRESHOLD_MAX) return 0;
+		return tune(&mmap_threshold, value);
+	case M_TRIM_THRESHOLD:
+		return tune(&trim_threshold, value);
+	case M_TOP_PAD:
+		return tune(&top_pad, value);
+	case M_PURGE_DECAY:
+		purge_decay = value;
+		return 1;
+	case M_HUGEPAGE:
+		__malloc_hugepage = !!value;
+		return 1;
+	case M_PROFILE_RATE:
+		if (value < 0) return 0;
+		if (value && !__malloc_prof_ring) {
+			/* The kernel keeps other mappings at least the stack
+			 * limit below the top of the main thread's stack. */
+			struct rlimit rl;
+			if (!__syscall(SYS_prlimit64, 0, RLIMIT_STACK, 0, &rl)
+			    && rl.rlim_cur < (size_t)-1/2)
+				prof_main_stack = rl.rlim_cur;
+			void *p = __mmap(0, PROF_RING * sizeof *__malloc_prof_ring,
+				PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED) return 0;
+			if (a_cas_p(&__malloc_prof_ring, 0, p))
+				__munmap(p, PROF_RING * sizeof *__malloc_prof_ring);
+		}
+		prof_rate = value;
+		return 1;
+	}
+	return 0;
+}
+
+void __malloc_init_env(void)
+{
+	static const struct {
+		char name[24];
+		int param;
+	} env[] = {
+		{ "MALLOC_MMAP_THRESHOLD_", M_MMAP_THRESHOLD },
+		{ "MALLOC_TRIM_THRESHOLD_", M_TRIM_THRESHOLD },
+		{ "MALLOC_TOP_PAD_", M_TOP_PAD },
+		{ "MALLOC_PURGE_DECAY", M_PURGE_DECAY },
+		{ "MALLOC_HUGEPAGE", M_HUGEPAGE },
+		{ "MALLOC_PROFILE_RATE", M_PROFILE_RATE },
+	};
+	char *s;
+	int i;
+
+	if (libc.secure) return;
+	for (i=0; i<sizeof env/sizeof *env; i++)
+		if ((s = getenv(env[i].name)))
+			mallopt(env[i].param, atoi(s));
+}
+
+void __malloc_heap_stats(struct heap_stats *st)
+{
+	struct chunk *c;
+	struct slab *r;
+	int i;
+
+	memset(st, 0, sizeof *st);
+	st->heap = mal.heap_size;
+	st->mmap_cnt = mal.mmap_cnt;
+	st->mmap_size = (size_t)mal.mmap_pages * PAGE_SIZE;
+	st->maps = (unsigned)mal.maps;
+	st->unmaps = (unsigned)mal.unmaps;
+
+	for (i=0; i<64; i++) {
+		lock_bin(i);
+		for (c=mal.bins[i].head; c!=BIN_TO_CHUNK(i); c=c->next) {
+			st->bin[i].cnt++;
+			st->bin[i].size += CHUNK_SIZE(c);
+			if (!CHUNK_SIZE(NEXT_CHUNK(c)))
+				st->top += CHUNK_SIZE(c);
+		}
+		st->bin[i].dirty = mal.dirty[i];
+		st->bin[i].contended = mal.contended[i];
+		unlock_bin(i);
+	}
+
+	for (i=0; i<SLAB_BINS; i++) {
+		lock(mal.slabs[i].lock);
+		for (r=mal.slabs[i].head; r; r=r->next) {
+			st->slab_cnt += r->avail;
+			st->slab_size += r->avail * r->size;
+		}
+		unlock(mal.slabs[i].lock);
+	}
+}
+
+/* Merge the dirty bytes of neighbor c into *dirty, keeping in *since
+ * the older stamp once old is set. */
+static void merge_dirty(struct chunk *c, size_t *dirty, size_t *since, int *old)
+{
+	size_t d = chunk_dirty(c);
+	if (!d) return;
+	if (!*old || CHUNK_SINCE(c) - *since > (size_t)-1/2)
+		*since = CHUNK_SINCE(c);
+	*old = 1;
+	*dirty += d;
+}
+
+/* Bin the in-use chunk self, counting its bytes as dirty unless clean
+ * is set, as for chunks that have just been purged. */
+static void bin_chunk(struct chunk *self, int clean)
 {
 	struct chunk *next = NEXT_CHUNK(self);
-	size_t final_size, new_size, size;
-	int reclaim=0;
+	size_t final_size, new_size, size, dirty, since = 0;
+	uintptr_t end = (uintptr_t)next, keep;
+	int reclaim=0, old=0;
 	int i;
 
 	final_size = new_size = CHUNK_SIZE(self);
+	dirty = clean ? 0 : new_size;
 
 	/* Crash on corrupted footer (likely from buffer overflow) */
 	if (next->psize != self->csize) a_crash();
@@ -467,6 +1225,7 @@ void __bin_chunk(struct chunk *self)
 		if (alloc_rev(self)) {
 			self = PREV_CHUNK(self);
 			size = CHUNK_SIZE(self);
+			merge_dirty(self, &dirty, &since, &old);
 			final_size += size;
 			if (new_size+size > RECLAIM && (new_size+size^size) > size)
 				reclaim = 1;
@@ -474,6 +1233,7 @@ void __bin_chunk(struct chunk *self)
 
 		if (alloc_fwd(next)) {
 			size = CHUNK_SIZE(next);
+			merge_dirty(next, &dirty, &since, &old);
 			final_size += size;
 			if (new_size+size > RECLAIM && (new_size+size^size) > size)
 				reclaim = 1;
@@ -486,6 +1246,25 @@ void __bin_chunk(struct chunk *self)
 
 	self->csize = final_size;
 	next->psize = final_size;
+
+	/* The chunk at the end of the heap is only dirty up to the
+	 * high-water mark kept by touch(). Once that part outgrows the
+	 * trim threshold it is released down to the top pad, as if the
+	 * heap had been shrunk, so that reusing less than the threshold
+	 * does not fault pages in again. A mark outside the chunk belongs
+	 * to another heap region; then only the freed chunk counts. */
+	keep = 0;
+	if (!CHUNK_SIZE(next)) {
+		reclaim = 0;
+		if (mal.top_dirty < (uintptr_t)self || mal.top_dirty > (uintptr_t)next)
+			mal.top_dirty = end;
+		if (mal.top_dirty - (uintptr_t)self > trim_threshold + top_pad) {
+			keep = (uintptr_t)CHUNK_TO_MEM(self) + top_pad
+				+ PAGE_SIZE-1 & -PAGE_SIZE;
+			end = mal.top_dirty + PAGE_SIZE-1 & -PAGE_SIZE;
+			mal.top_dirty = keep;
+		}
+	}
 	unlock(mal.free_lock);
 
 	self->next = BIN_TO_CHUNK(i);
@@ -493,10 +1272,23 @@ void __bin_chunk(struct chunk *self)
 	self->next->prev = self;
 	self->prev->next = self;
 
+	/* The freed bytes and the dirty bytes of merged neighbors bound
+	 * the dirty bytes of the result. */
+	uintptr_t a, b;
+	size = chunk_pages(self, &a, &b);
+	if (dirty > size) dirty = size;
+
+	if (keep) {
+		if (keep > a) a = keep;
+		if (end < b) b = end;
+		reclaim = b > a;
+		if (dirty > a - (uintptr_t)self) dirty = a - (uintptr_t)self;
+	} else if (reclaim) {
+		dirty = 0;
+	}
+
 	/* Replace middle of large chunks with fresh zero pages */
 	if (reclaim) {
-		uintptr_t a = (uintptr_t)self + SIZE_ALIGN+PAGE_SIZE-1 & -PAGE_SIZE;
-		uintptr_t b = (uintptr_t)next - SIZE_ALIGN & -PAGE_SIZE;
 #if 1
 		__madvise((void *)a, b-a, MADV_DONTNEED);
 #else
@@ -505,7 +1297,23 @@ void __bin_chunk(struct chunk *self)
 #endif
 	}
 
+	/* Leave other dirty pages for the decay purge */
+	if (size) {
+		if (dirty && !old) since = purge_clock();
+		CHUNK_SINCE(self) = since;
+		CHUNK_DIRTY(self) = dirty;
+		mal.dirty[i] += dirty;
+	}
+
 	unlock_bin(i);
+
+	if (size && dirty && !clean)
+		purge_decayed(1, since, old ? purge_clock() : since);
+}
+
+void __bin_chunk(struct chunk *self)
+{
+	bin_chunk(self, 0);
 }
 
 static void unmap_chunk(struct chunk *self)
@@ -515,7 +1323,24 @@ static void unmap_chunk(struct chunk *self)
 	size_t len = CHUNK_SIZE(self) + extra;
 	/* Crash on double free */
 	if (extra & 1) a_crash();
+
+	/* Like glibc, raise the mmap threshold to the size of freed
+	 * mmapped chunks unless it has been set explicitly, so that
+	 * buffers of that size are reused from the heap instead. */
+	if (!tuned && CHUNK_SIZE(self) > mmap_threshold
+	    && CHUNK_SIZE(self) <= MMAP_THRESHOLD_MAX) {
+		lock(mal.tune_lock);
+		if (!tuned && CHUNK_SIZE(self) > mmap_threshold) {
+			mmap_threshold = CHUNK_SIZE(self);
+			trim_threshold = 2*CHUNK_SIZE(self);
+		}
+		unlock(mal.tune_lock);
+	}
+
 	__munmap(base, len);
+	a_inc(&mal.unmaps);
+	a_dec(&mal.mmap_cnt);
+	a_fetch_add(&mal.mmap_pages, -(int)(len/PAGE_SIZE));
 }
 
 void free(void *p)
@@ -524,12 +1349,116 @@ void free(void *p)
 
 	struct chunk *self = MEM_TO_CHUNK(p);
 
+	/* Arena memory is only released with its arena. */
+	if (IS_ARENA(self)) return;
+
 	if (IS_MMAPPED(self))
 		unmap_chunk(self);
+	else if (CHUNK_SIZE(self) <= CACHE_BINS*SIZE_ALIGN && libc.threaded)
+		cache_put(__pthread_self(), self);
+	else if (IS_SLAB(self))
+		slab_free(self);
 	else
 		__bin_chunk(self);
 }
 
+/* The size cannot pick the path a chunk is freed by: realloc, memalign
+ * and thread cache fills leave chunks larger than, or of another kind
+ * than, their requested size implies, and only the header tells. So
+ * this is plain free, with no extra work for the size. */
+void free_sized(void *p, size_t n)
+{
+	free(p);
+}
+
+size_t malloc_bulk(size_t n, size_t cnt, void **p)
+{
+	struct chunk *c[64];
+	size_t k, m, got, j;
+
+	if (adjust_size(&n) < 0) return 0;
+
+	if (n > mmap_threshold || __malloc_arena_used
+	    && __pthread_self()->malloc_arena) {
+		for (k=0; k<cnt && (p[k] = malloc(n-OVERHEAD)); k++);
+		return k;
+	}
+
+	/* Chunks are gathered in batches on the stack rather than in p,
+	 * which holds void pointers. */
+	for (k=0; k<cnt; k+=m) {
+		m = cnt-k < sizeof c/sizeof *c ? cnt-k : sizeof c/sizeof *c;
+		if (n <= SLAB_MAX) got = slab_alloc(n, c, m);
+		else got = carve(n, c, m);
+		for (j=0; j<got; j++) p[k+j] = CHUNK_TO_MEM(c[j]);
+		if (got < m) return k+got;
+	}
+	return cnt;
+}
+
+void free_bulk(size_t cnt, void **p)
+{
+	struct chunk *self, *next, *r;
+	struct slab *empty, *e;
+	size_t k = 0;
+	int i;
+
+	while (k < cnt) {
+		if (!p[k]) {
+			k++;
+			continue;
+		}
+		self = MEM_TO_CHUNK(p[k++]);
+
+		if (IS_ARENA(self)) continue;
+
+		if (IS_MMAPPED(self)) {
+			unmap_chunk(self);
+			continue;
+		}
+
+		/* Return consecutive slots of one size under one lock. */
+		if (IS_SLAB(self)) {
+			i = CHUNK_SIZE(self) / SIZE_ALIGN - 1;
+			empty = 0;
+			lock(mal.slabs[i].lock);
+			for (;;) {
+				if ((r = slab_put(self, i))) {
+					e = CHUNK_TO_MEM(r);
+					e->next = empty;
+					empty = e;
+				}
+				if (k == cnt || !p[k]) break;
+				self = MEM_TO_CHUNK(p[k]);
+				if (!IS_SLAB(self) || CHUNK_SIZE(self) != (i+1)*SIZE_ALIGN)
+					break;
+				k++;
+			}
+			unlock(mal.slabs[i].lock);
+			/* Runs that became empty are binned without the slab
+			 * lock held, since binning may purge. */
+			for (; empty; empty=e) {
+				e = empty->next;
+				__bin_chunk(MEM_TO_CHUNK(empty));
+			}
+			continue;
+		}
+
+		/* Merge address-adjacent chunks, such as those made by
+		 * malloc_bulk, so the run is binned all at once. */
+		for (; k < cnt && p[k]; k++) {
+			next = MEM_TO_CHUNK(p[k]);
+			if (next != NEXT_CHUNK(self) || IS_MMAPPED(next)
+			    || IS_SLAB(next) || IS_ARENA(next)) break;
+			/* Crash on corrupted footer (likely from buffer overflow) */
+			if (next->psize != self->csize) a_crash();
+			self->csize += CHUNK_SIZE(next);
+			NEXT_CHUNK(self)->psize = self->csize;
+		}
+		__bin_chunk(self);
+	}
+}
+
 void __malloc_donate(char *start, char *end)
 {
 	size_t align_start_up = (SIZE_ALIGN-1) & (-(uintptr_t)start - OVERHEAD);
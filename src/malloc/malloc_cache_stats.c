@@ -0,0 +1,26 @@
+#include "pthread_impl.h"
+#include "malloc_impl.h"
+
+/* Thread caches are only ever touched by their own thread, so each
+ * thread adds its counts from a synccall, which runs them one at a
+ * time. This lives apart from malloc.c so that programs that do not
+ * ask for statistics do not link __synccall. */
+
+static void add_cache(void *p)
+{
+	struct heap_stats *st = p;
+	pthread_t self = __pthread_self();
+	size_t i, n;
+
+	for (i=0; i<MALLOC_CACHE_BINS; i++) {
+		n = self->malloc_cache[i].count;
+		st->cache_cnt += n;
+		st->cache_size += n * (i+1) * SIZE_ALIGN;
+	}
+}
+
+void __malloc_cache_stats(struct heap_stats *st)
+{
+	st->cache_cnt = st->cache_size = 0;
+	__synccall(add_cache, st);
+}
@@ -0,0 +1,16 @@
+#include <stdlib.h>
+#include "pthread_impl.h"
+#include "malloc_impl.h"
+
+/* For memory libc allocates on its own behalf that must outlive any
+ * arena the calling thread has selected, such as printf plan caches.
+ * It goes through malloc, so a replaced malloc and free still pair. */
+void *__malloc_heap(size_t n)
+{
+	pthread_t self = __pthread_self();
+	void *a = self->malloc_arena, *p;
+	self->malloc_arena = 0;
+	p = malloc(n);
+	self->malloc_arena = a;
+	return p;
+}
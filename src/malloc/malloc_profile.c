@@ -0,0 +1,56 @@
+#include <malloc.h>
+#include <stdio.h>
+#include "atomic.h"
+#include "malloc_impl.h"
+
+/* Samples are published in the ring with their sequence number stored
+ * last; a slot whose number changes while being copied was overwritten
+ * by a writer that lapped the reader. Sequence numbers and positions
+ * count modulo 2^32 and are compared by their difference, so they
+ * keep working when the counter wraps; 0 is never used. */
+
+size_t malloc_profile_read(struct malloc_sample *buf, size_t n, size_t *pos)
+{
+	struct malloc_sample *ring = __malloc_prof_ring, *s;
+	unsigned head, seq, cur;
+	size_t k = 0;
+
+	if (!ring) return 0;
+	head = __malloc_prof_head;
+	seq = *pos + 1;
+	if (head - seq + 1 > PROF_RING)
+		seq = head - PROF_RING + 1;
+
+	for (; seq - 1 != head && k < n; seq++) {
+		if (!seq) continue;
+		s = ring + seq % PROF_RING;
+		cur = *(volatile size_t *)&s->seq;
+		/* Stop at a sample still being written. */
+		if (!cur || (int)(cur - seq) < 0) break;
+		if (cur != seq) continue;
+		a_barrier();
+		buf[k] = *s;
+		a_barrier();
+		if (*(volatile size_t *)&s->seq == seq) k++;
+	}
+	*pos = seq - 1;
+	return k;
+}
+
+int malloc_profile_dump(int fd)
+{
+	struct malloc_sample buf[16];
+	size_t pos = 0, cnt, i, d;
+
+	while ((cnt = malloc_profile_read(buf, 16, &pos))) {
+		for (i=0; i<cnt; i++) {
+			if (dprintf(fd, "%zu %p", buf[i].size, buf[i].caller) < 0)
+				return -1;
+			for (d=0; d<buf[i].depth; d++)
+				if (dprintf(fd, " %p", buf[i].stack[d]) < 0)
+					return -1;
+			if (dprintf(fd, "\n") < 0) return -1;
+		}
+	}
+	return 0;
+}
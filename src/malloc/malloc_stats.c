@@ -0,0 +1,35 @@
+#include <malloc.h>
+#include <stdio.h>
+#include "libc.h"
+#include "malloc_impl.h"
+
+void malloc_stats(void)
+{
+	struct heap_stats st;
+	size_t free = 0;
+	int i;
+
+	__malloc_heap_stats(&st);
+	__malloc_cache_stats(&st);
+	for (i=0; i<64; i++) free += st.bin[i].size;
+
+	fprintf(stderr, "heap bytes       = %10zu\n", st.heap);
+	fprintf(stderr, "in use bytes     = %10zu\n",
+		st.heap - free - st.slab_size - st.cache_size);
+	fprintf(stderr, "free bytes       = %10zu\n", free);
+	fprintf(stderr, "top free bytes   = %10zu\n", st.top);
+	fprintf(stderr, "free slab slots  = %10zu (%zu bytes)\n",
+		st.slab_cnt, st.slab_size);
+	fprintf(stderr, "cached chunks    = %10zu (%zu bytes)\n",
+		st.cache_cnt, st.cache_size);
+	fprintf(stderr, "mmap regions     = %10zu (%zu bytes)\n",
+		st.mmap_cnt, st.mmap_size);
+	fprintf(stderr, "mmap/munmap      = %10zu/%zu\n", st.maps, st.unmaps);
+
+	for (i=0; i<64; i++) {
+		if (!st.bin[i].cnt && !st.bin[i].contended) continue;
+		fprintf(stderr, "bin %2d: %8zu free %10zu bytes %10zu dirty %8u contended\n",
+			i, st.bin[i].cnt, st.bin[i].size,
+			st.bin[i].dirty, st.bin[i].contended);
+	}
+}
@@ -21,7 +21,9 @@ void *__memalign(size_t align, size_t len)
 	if (align <= SIZE_ALIGN)
 		return malloc(len);
 
-	if (!(mem = malloc(len + align-1)))
+	/* Slab slots cannot be split, so ask for a size that is
+	 * always served by an ordinary chunk. */
+	if (!(mem = malloc(len + align-1 > SLAB_MAX ? len + align-1 : SLAB_MAX)))
 		return 0;
 
 	new = (void *)((uintptr_t)mem + align-1 & -align);
@@ -38,6 +40,14 @@ void *__memalign(size_t align, size_t len)
 		return new;
 	}
 
+	if (IS_ARENA(c)) {
+		/* Arena chunks are never freed individually, so the
+		 * unused head can simply be abandoned. */
+		n->psize = 0;
+		n->csize = c->csize - (new-mem);
+		return new;
+	}
+
 	struct chunk *t = NEXT_CHUNK(c);
 
 	/* Split the allocated chunk into two chunks. The aligned part
@@ -51,6 +51,10 @@ FILE *__fdopen(int fd, const char *mode)
 	f->seek = __stdio_seek;
 	f->close = __stdio_close;
 
+	/* Serve reads from a mapping of regular files if requested */
+	if (*mode == 'r' && !strchr(mode, '+') && strchr(mode, 'm'))
+		__stdio_mmap(f);
+
 	if (!libc.threaded) f->lock = -1;
 
 	/* Add new FILE to open file list */
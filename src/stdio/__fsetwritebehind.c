@@ -0,0 +1,298 @@
+#include "stdio_impl.h"
+#include "pthread_impl.h"
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+
+/* Write-behind streams hand their buffer to a background thread shared
+ * by all such streams whenever stdio would write it out, and carry on
+ * in the next of NSLOT buffers, waiting only when that one is still
+ * queued. Writes too large for a buffer are made directly once the
+ * queue for the stream has drained. Explicit flushes (write with len
+ * 0), seeks and close wait for all of the stream's buffers; F_ASYNC
+ * makes fflush and exit do so even when the current buffer is empty.
+ * Errors from the thread are reported by the next write or flush. A
+ * forked child drops the queue, which the parent goes on writing, and
+ * starts its own thread when it next needs one. */
+
+#define NSLOT 4
+
+struct slot {
+	struct slot *next;
+	struct wb *w;
+	size_t len;
+	volatile int busy;
+	unsigned char *data;
+};
+
+struct wb {
+	struct wb *next;
+	int fd;
+	volatile int err;
+	int cur;
+	size_t cap;
+	unsigned char *buf;
+	size_t (*write)(FILE *, const unsigned char *, size_t);
+	off_t (*seek)(FILE *, off_t, int);
+	int (*close)(FILE *);
+	struct slot slot[NSLOT];
+};
+
+static volatile int lock[1];
+static volatile int seq;
+static struct slot *head, *tail;
+static struct wb *all;
+static int running, atfork;
+
+static int write_all(int fd, const unsigned char *p, size_t n)
+{
+	long r;
+	for (; n; p+=r, n-=r) {
+		r = __syscall(SYS_write, fd, p, n);
+		if (r == -EINTR) r = 0;
+		else if (r < 0) return -1;
+	}
+	return 0;
+}
+
+static void *flusher(void *p)
+{
+	struct slot *s;
+	int cur;
+
+	for (;;) {
+		cur = seq;
+		LOCK(lock);
+		if ((s = head) && !(head = s->next)) tail = 0;
+		UNLOCK(lock);
+		if (!s) {
+			__wait(&seq, 0, cur, 1);
+			continue;
+		}
+		if (write_all(s->w->fd, s->data, s->len)) s->w->err = 1;
+		a_store(&s->busy, 0);
+		__wake(&s->busy, -1, 1);
+	}
+	return 0;
+}
+
+static void child(void)
+{
+	struct wb *w;
+	int i;
+
+	for (w=all; w; w=w->next)
+		for (i=0; i<NSLOT; i++)
+			w->slot[i].busy = 0;
+	head = tail = 0;
+	running = 0;
+	lock[0] = 0;
+}
+
+static int start(void)
+{
+	pthread_attr_t a;
+	sigset_t set, old;
+	pthread_t td;
+
+	if (running) return 0;
+	if (!atfork && pthread_atfork(0, 0, child)) return -1;
+	atfork = 1;
+	pthread_attr_init(&a);
+	pthread_attr_setstacksize(&a, PTHREAD_STACK_MIN);
+	pthread_attr_setdetachstate(&a, PTHREAD_CREATE_DETACHED);
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+	running = !pthread_create(&td, &a, flusher, 0);
+	pthread_sigmask(SIG_SETMASK, &old, 0);
+	return running ? 0 : -1;
+}
+
+static struct slot *submit(struct wb *w, struct slot *s, size_t len)
+{
+	s->len = len;
+	s->busy = 1;
+	s->next = 0;
+	LOCK(lock);
+	if (start()) {
+		/* No thread to hand off to; write in place. */
+		UNLOCK(lock);
+		if (write_all(w->fd, s->data, len)) w->err = 1;
+		s->busy = 0;
+		return s;
+	}
+	if (tail) tail->next = s;
+	else head = s;
+	tail = s;
+	UNLOCK(lock);
+	a_inc(&seq);
+	__wake(&seq, 1, 1);
+
+	w->cur = (w->cur + 1) % NSLOT;
+	s = w->slot + w->cur;
+	while (s->busy) __wait(&s->busy, 0, 1, 1);
+	return s;
+}
+
+static void drain(struct wb *w)
+{
+	int i;
+	for (i=0; i<NSLOT; i++)
+		while (w->slot[i].busy) __wait(&w->slot[i].busy, 0, 1, 1);
+}
+
+static size_t wb_write(FILE *f, const unsigned char *buf, size_t len)
+{
+	struct wb *w = f->cookie;
+	struct slot *s = w->slot + w->cur;
+	size_t used = f->wpos - f->wbase, ret = len;
+
+	/* Pending output is normally already in the current slot, but it
+	 * can be in a buffer lent to the stream, such as vfprintf's for
+	 * unbuffered streams. That buffer ends at f->wend, so new data is
+	 * always appended in the slot. */
+	if (used && f->wbase != s->data) {
+		if (used <= w->cap) {
+			memcpy(s->data, f->wbase, used);
+		} else {
+			drain(w);
+			if (write_all(w->fd, f->wbase, used)) w->err = 1;
+			used = 0;
+		}
+	}
+	if (len && used + len <= w->cap) {
+		memcpy(s->data + used, buf, len);
+		used += len;
+		len = 0;
+	}
+	if (used) s = submit(w, s, used);
+	if (len && len <= w->cap) {
+		memcpy(s->data, buf, len);
+		s = submit(w, s, len);
+		len = 0;
+	}
+	if (len || !ret) drain(w);
+	if (len && write_all(w->fd, buf, len)) w->err = 1;
+
+	f->buf = s->data;
+	f->wpos = f->wbase = f->buf;
+	f->wend = f->buf + f->buf_size;
+	if (w->err) {
+		w->err = 0;
+		f->wpos = f->wbase = f->wend = 0;
+		f->flags |= F_ERR;
+		return 0;
+	}
+	return ret;
+}
+
+static off_t wb_seek(FILE *f, off_t off, int whence)
+{
+	struct wb *w = f->cookie;
+	drain(w);
+	return w->seek(f, off, whence);
+}
+
+static void stop(FILE *f)
+{
+	struct wb *w = f->cookie, **p;
+	drain(w);
+	LOCK(lock);
+	for (p=&all; *p!=w; p=&(*p)->next);
+	*p = w->next;
+	UNLOCK(lock);
+	f->buf = w->buf;
+	f->wpos = f->wbase = f->wend = 0;
+	f->write = w->write;
+	f->seek = w->seek;
+	f->close = w->close;
+	f->cookie = 0;
+	f->flags &= ~F_ASYNC;
+	free(w);
+}
+
+static int wb_close(FILE *f)
+{
+	stop(f);
+	return f->close(f);
+}
+
+int __fsetwritebehind(FILE *f, int on)
+{
+	struct wb *w;
+	size_t cap = f->buf_size > BUFSIZ ? f->buf_size : BUFSIZ;
+	struct winsize wsz;
+	int i, ret = 0;
+
+	FLOCK(f);
+	if (!on) {
+		if (f->write == wb_write) {
+			if (f->wpos > f->wbase) f->write(f, 0, 0);
+			stop(f);
+		}
+		goto out;
+	}
+	if (f->write == wb_write) goto out;
+	/* Unbuffered streams are written at once, not behind. */
+	if (!(f->flags & F_NORD) || !f->buf_size
+	    || (f->write != __stdio_write && f->write != __stdout_write)) {
+		errno = EINVAL;
+		ret = -1;
+		goto out;
+	}
+
+	LOCK(lock);
+	ret = start();
+	UNLOCK(lock);
+	if (ret) {
+		errno = EAGAIN;
+		goto out;
+	}
+
+	/* Write out anything buffered before switching buffers. */
+	if (f->wpos > f->wbase) {
+		f->write(f, 0, 0);
+		if (!f->wpos) {
+			ret = -1;
+			goto out;
+		}
+	}
+	if (!(w = malloc(sizeof *w + NSLOT*cap))) {
+		ret = -1;
+		goto out;
+	}
+	memset(w, 0, sizeof *w);
+	w->fd = f->fd;
+	w->cap = cap;
+	w->buf = f->buf;
+	w->write = f->write;
+	w->seek = f->seek;
+	w->close = f->close;
+	for (i=0; i<NSLOT; i++) {
+		w->slot[i].w = w;
+		w->slot[i].data = (unsigned char *)(w+1) + i*cap;
+	}
+	LOCK(lock);
+	w->next = all;
+	all = w;
+	UNLOCK(lock);
+
+	/* As __stdout_write would on the first write */
+	if (f->write == __stdout_write && !(f->flags & F_SVB)
+	    && __syscall(SYS_ioctl, f->fd, TIOCGWINSZ, &wsz))
+		f->lbf = EOF;
+
+	f->cookie = w;
+	f->buf = w->slot[0].data;
+	f->wpos = f->wbase = f->wend = 0;
+	f->write = wb_write;
+	f->seek = wb_seek;
+	f->close = wb_close;
+	f->flags |= F_ASYNC;
+out:
+	FUNLOCK(f);
+	return ret;
+}
@@ -3,23 +3,91 @@
 
 #define MAYBE_WAITERS 0x40000000
 
+/* The first thread to lock a stream takes a bias on it and from then
+ * on locks it by storing to f->bias_held, with no atomic operations.
+ * Anyone else needing the stream takes the lock word and revokes the
+ * bias: it sets f->bias_revoke and forces a memory barrier on every
+ * thread, after which the owner either sees the request when entering
+ * or is seen inside and waited for. Revoked streams keep using the
+ * lock word. flockfile needs the lock word and revokes too. */
+
+#define compiler_barrier() __asm__ __volatile__ ("" : : : "memory")
+
+static void dummy(void *p)
+{
+}
+
+static void barrier_all(void)
+{
+#ifdef SYS_membarrier
+	/* MEMBARRIER_CMD_PRIVATE_EXPEDITED, registering on first use */
+	if (!__syscall(SYS_membarrier, 8, 0)) return;
+	if (!__syscall(SYS_membarrier, 16, 0)
+	    && !__syscall(SYS_membarrier, 8, 0)) return;
+#endif
+	__synccall(dummy, 0);
+}
+
+/* Called with the lock word held. Unless wait is set, returns -1
+ * rather than waiting when the owner is inside; the bias stays
+ * revoked and the owner falls back to the lock word next time. */
+int __unbiasfile(FILE *f, int wait)
+{
+	int bias = f->bias;
+	if (bias < 0) return 0;
+	if (!bias && !(bias = a_cas(&f->bias, 0, -1))) return 0;
+	if (bias != __pthread_self()->tid) {
+		a_store(&f->bias_revoke, 1);
+		barrier_all();
+		if (f->bias_held && !wait) return -1;
+		while (f->bias_held) __wait(&f->bias_held, 0, 1, 1);
+		/* Make the owner's last stores visible here. */
+		barrier_all();
+	}
+	f->bias = -1;
+	return 0;
+}
+
 int __lockfile(FILE *f)
 {
 	int owner = f->lock, tid = __pthread_self()->tid;
+	if (f->bias == tid || (!f->bias && !a_cas(&f->bias, 0, tid))) {
+		if (f->bias_held) return 0;
+		f->bias_held = 1;
+		compiler_barrier();
+		if (!f->bias_revoke) return 1;
+		f->bias_held = 0;
+		__wake(&f->bias_held, 1, 1);
+		owner = f->lock;
+	}
 	if ((owner & ~MAYBE_WAITERS) == tid)
 		return 0;
 	for (;;) {
 		owner = a_cas(&f->lock, 0, tid);
-		if (!owner) return 1;
+		if (!owner) goto out;
 		if (a_cas(&f->lock, owner, owner|MAYBE_WAITERS)==owner) break;
 	}
-	while ((owner = a_cas(&f->lock, 0, tid|MAYBE_WAITERS)))
-		__futexwait(&f->lock, owner, 1);
+	while ((owner = a_cas(&f->lock, 0, tid|MAYBE_WAITERS))) {
+		if ((owner & MAYBE_WAITERS) ||
+		    a_cas(&f->lock, owner, owner|MAYBE_WAITERS)==owner)
+			__futexwait(&f->lock, owner|MAYBE_WAITERS, 1);
+	}
+out:
+	__unbiasfile(f, 1);
 	return 1;
 }
 
 void __unlockfile(FILE *f)
 {
+	/* Only the owner of the bias can have locked by it; anyone else
+	 * holds the lock word, whatever bias_held says meanwhile. */
+	if (f->bias_held && f->bias == __pthread_self()->tid) {
+		compiler_barrier();
+		f->bias_held = 0;
+		compiler_barrier();
+		if (f->bias_revoke) __wake(&f->bias_held, 1, 1);
+		return;
+	}
 	if (a_swap(&f->lock, 0) & MAYBE_WAITERS)
 		__wake(&f->lock, 1, 1);
 }
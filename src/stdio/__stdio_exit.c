@@ -9,7 +9,7 @@ static void close_file(FILE *f)
 {
 	if (!f) return;
 	FFINALLOCK(f);
-	if (f->wpos > f->wbase) f->write(f, 0, 0);
+	if (f->wpos > f->wbase || f->flags & F_ASYNC) f->write(f, 0, 0);
 	if (f->rpos < f->rend) f->seek(f, f->rpos-f->rend, SEEK_CUR);
 }
 
@@ -19,6 +19,7 @@ void __stdio_exit(void)
 	for (f=*__ofl_lock(); f; f=f->next) close_file(f);
 	close_file(__stdin_used);
 	close_file(__stdout_used);
+	close_file(__stderr_used);
 }
 
 weak_alias(__stdio_exit, __stdio_exit_needed);
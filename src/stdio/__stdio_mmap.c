@@ -0,0 +1,128 @@
+#define _GNU_SOURCE
+#include "stdio_impl.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "malloc_impl.h"
+
+/* Streams opened for reading with the "m" mode flag serve reads from a
+ * private mapping of the file: the read buffer pointers are set to the
+ * unread part of the mapping, as __string_read does for strings. ungetc
+ * hands such data back with a seek instead of writing to it; the page
+ * below the mapping only guards against stray writes. pos is the
+ * file offset at the end of the buffered data; the descriptor offset
+ * is only moved by seeks. Once reads reach the end of the mapping, the
+ * stream reverts to plain descriptor reads, which also picks up any
+ * data appended since opening.
+ *
+ * Touching a mapped page past the end of a file truncated since it
+ * was mapped raises SIGBUS. The mapping is therefore handed out at
+ * most MAP_WINDOW bytes at a time, each after checking with fstat
+ * that the file has not shrunk; if it has, the stream reverts to
+ * descriptor reads. Truncation while a window is being consumed can
+ * still fault, as with any mapping of a shared file. */
+
+#define MAP_WINDOW (256<<10)
+
+struct map {
+	unsigned char *base;
+	size_t size;
+	off_t pos;
+};
+
+static size_t mmap_read(FILE *f, unsigned char *buf, size_t len)
+{
+	struct map *m = f->cookie;
+	struct stat st;
+	size_t k;
+
+	if (m->pos >= m->size || __syscall(SYS_fstat, f->fd, &st)
+	    || st.st_size < m->size) {
+		if (__stdio_seek(f, m->pos, SEEK_SET) < 0) {
+			f->flags |= F_ERR;
+			return 0;
+		}
+		__stdio_munmap(f);
+		return f->read(f, buf, len);
+	}
+	k = m->size - m->pos;
+	if (k > MAP_WINDOW) k = MAP_WINDOW;
+	if (k < len) len = k;
+	memcpy(buf, m->base + m->pos, len);
+	f->rpos = m->base + m->pos + len;
+	f->rend = m->base + m->pos + k;
+	m->pos += k;
+	return len;
+}
+
+static off_t mmap_seek(FILE *f, off_t off, int whence)
+{
+	struct map *m = f->cookie;
+	off_t pos;
+
+	if (whence == SEEK_CUR) {
+		off += m->pos;
+		whence = SEEK_SET;
+	}
+	pos = __stdio_seek(f, off, whence);
+	if (pos >= 0) m->pos = pos;
+	return pos;
+}
+
+static int mmap_close(FILE *f)
+{
+	__stdio_munmap(f);
+	return f->close(f);
+}
+
+void __stdio_mmap(FILE *f)
+{
+	struct stat st;
+	struct map *m;
+	unsigned char *p;
+	off_t pos;
+
+	if (__syscall(SYS_fstat, f->fd, &st) || !S_ISREG(st.st_mode)
+	    || !st.st_size || st.st_size >= PTRDIFF_MAX - PAGE_SIZE)
+		return;
+	if ((pos = __stdio_seek(f, 0, SEEK_CUR)) < 0) return;
+	if (!(m = malloc(sizeof *m))) return;
+	p = __mmap(0, st.st_size + PAGE_SIZE, PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		free(m);
+		return;
+	}
+	if (__mmap(p + PAGE_SIZE, st.st_size, PROT_READ|PROT_WRITE,
+	    MAP_PRIVATE|MAP_FIXED, f->fd, 0) == MAP_FAILED) {
+		__munmap(p, st.st_size + PAGE_SIZE);
+		free(m);
+		return;
+	}
+	__madvise(p + PAGE_SIZE, st.st_size, MADV_SEQUENTIAL);
+	m->base = p + PAGE_SIZE;
+	m->size = st.st_size;
+	m->pos = pos;
+	f->cookie = m;
+	f->read = mmap_read;
+	f->seek = mmap_seek;
+	f->close = mmap_close;
+}
+
+/* Revert to descriptor reads. Callers have already consumed or synced
+ * any buffered data, which would point into the mapping. */
+void __stdio_munmap(FILE *f)
+{
+	struct map *m = f->cookie;
+
+	if (f->read != mmap_read) return;
+	f->rpos = f->rend = 0;
+	__munmap(m->base - PAGE_SIZE, m->size + PAGE_SIZE);
+	free(m);
+	f->cookie = 0;
+	f->read = __stdio_read;
+	f->seek = __stdio_seek;
+	f->close = __stdio_close;
+}
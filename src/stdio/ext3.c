@@ -0,0 +1,53 @@
+#include "stdio_impl.h"
+#include <stdio_ext.h>
+#include <string.h>
+
+/* Direct access to the buffer. Pointers stay valid until the next
+ * operation on the stream; callers sharing the stream between threads
+ * should hold flockfile across the access and the matching increment. */
+
+const char *__freadpeek(FILE *f, size_t *sizep)
+{
+	const char *p = 0;
+	int c;
+
+	FLOCK(f);
+	if (f->rpos == f->rend) {
+		/* Refill by reading one byte and pushing it back; it is
+		 * already in place unless the stream is unbuffered. */
+		c = __uflow(f);
+		if (c != EOF && *--f->rpos != c) *f->rpos = c;
+	}
+	if (f->rpos != f->rend) {
+		*sizep = f->rend - f->rpos;
+		p = (const char *)f->rpos;
+	}
+	FUNLOCK(f);
+	return p;
+}
+
+char *__fwriteptr(FILE *f, size_t n, size_t *sizep)
+{
+	char *p = 0;
+
+	FLOCK(f);
+	if (!n) n = 1;
+	if ((f->wend || !__towrite(f)) && n <= f->buf_size) {
+		if (f->wend - f->wpos < n) f->write(f, 0, 0);
+		if (f->wend) {
+			*sizep = f->wend - f->wpos;
+			p = (char *)f->wpos;
+		}
+	}
+	FUNLOCK(f);
+	return p;
+}
+
+void __fwriteptrinc(FILE *f, size_t inc)
+{
+	FLOCK(f);
+	f->wpos += inc;
+	if (f->lbf >= 0 && memchr(f->wpos - inc, f->lbf, inc))
+		f->write(f, 0, 0);
+	FUNLOCK(f);
+}
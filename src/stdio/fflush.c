@@ -11,7 +11,8 @@ int fflush(FILE *f)
 
 		for (f=*__ofl_lock(); f; f=f->next) {
 			FLOCK(f);
-			if (f->wpos > f->wbase) r |= fflush(f);
+			if (f->wpos > f->wbase || f->flags & F_ASYNC)
+				r |= fflush(f);
 			FUNLOCK(f);
 		}
 		__ofl_unlock();
@@ -21,8 +22,9 @@ int fflush(FILE *f)
 
 	FLOCK(f);
 
-	/* If writing, flush output */
-	if (f->wpos > f->wbase) {
+	/* If writing, flush output, including any still being written
+	 * behind by __fsetwritebehind */
+	if (f->wpos > f->wbase || f->flags & F_ASYNC) {
 		f->write(f, 0, 0);
 		if (!f->wpos) {
 			FUNLOCK(f);
@@ -6,9 +6,12 @@ char *fgetln(FILE *f, size_t *plen)
 {
 	char *ret = 0, *z;
 	ssize_t l;
+	int c;
 	FLOCK(f);
-	ungetc(getc_unlocked(f), f);
-	if ((z=memchr(f->rpos, '\n', f->rend - f->rpos))) {
+	/* Refill an empty buffer, pushing the byte read back in place. */
+	if (f->rpos == f->rend && (c = __uflow(f)) != EOF && *--f->rpos != c)
+		*f->rpos = c;
+	if (f->rpos != f->rend && (z=memchr(f->rpos, '\n', f->rend - f->rpos))) {
 		ret = (char *)f->rpos;
 		*plen = ++z - ret;
 		f->rpos = (void *)z;
@@ -0,0 +1,24 @@
+#define _GNU_SOURCE
+#include "stdio_impl.h"
+#include <string.h>
+
+/* Return up to n lines in place, as fgetln does: every complete line
+ * already buffered, or failing that one line read with fgetln. */
+
+size_t fgetlns(FILE *f, char **lines, size_t *lens, size_t n)
+{
+	unsigned char *z;
+	size_t i = 0;
+
+	if (!n) return 0;
+	FLOCK(f);
+	while (i < n && f->rpos != f->rend
+	       && (z = memchr(f->rpos, '\n', f->rend - f->rpos))) {
+		lines[i] = (char *)f->rpos;
+		lens[i++] = ++z - f->rpos;
+		f->rpos = z;
+	}
+	if (!i && (lines[0] = fgetln(f, lens))) i = 1;
+	FUNLOCK(f);
+	return i;
+}
@@ -0,0 +1,13 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdarg.h>
+
+int fprintf_plan(FILE *restrict f, const printf_plan_t *plan, ...)
+{
+	int ret;
+	va_list ap;
+	va_start(ap, plan);
+	ret = vfprintf_plan(f, plan, ap);
+	va_end(ap);
+	return ret;
+}
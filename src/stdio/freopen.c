@@ -27,6 +27,7 @@ FILE *freopen(const char *restrict filename, const char *restrict mode, FILE *re
 		if (syscall(SYS_fcntl, f->fd, F_SETFL, fl) < 0)
 			goto fail;
 	} else {
+		__stdio_munmap(f);
 		f2 = fopen(filename, mode);
 		if (!f2) goto fail;
 		if (f2->fd == f->fd) f2->fd = -1; /* avoid closing in fclose */
@@ -38,6 +39,10 @@ FILE *freopen(const char *restrict filename, const char *restrict mode, FILE *re
 		f->seek = f2->seek;
 		f->close = f2->close;
 
+		/* A mapping made for f2 is handed over to f. */
+		f->cookie = f2->cookie;
+		f2->close = __stdio_close;
+
 		fclose(f2);
 	}
 
@@ -41,8 +41,13 @@ int ftrylockfile(FILE *f)
 		return 0;
 	}
 	if (owner < 0) f->lock = owner = 0;
-	if (owner || a_cas(&f->lock, 0, tid))
+	if (owner || f->bias_held || a_cas(&f->lock, 0, tid))
 		return -1;
+	if (__unbiasfile(f, 0)) {
+		if (a_swap(&f->lock, 0) & MAYBE_WAITERS)
+			__wake(&f->lock, 1, 1);
+		return -1;
+	}
 	__register_locked_file(f, self);
 	return 0;
 }
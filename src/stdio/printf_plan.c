@@ -0,0 +1,20 @@
+#define _GNU_SOURCE
+#include "stdio_impl.h"
+#include <stdlib.h>
+
+printf_plan_t *printf_plan_create(const char *fmt)
+{
+	size_t n = __printf_plan_size(fmt);
+	printf_plan_t *plan;
+	if (!n || !(plan = malloc(n))) return 0;
+	if (__printf_compile(plan, fmt)) {
+		free(plan);
+		return 0;
+	}
+	return plan;
+}
+
+void printf_plan_free(printf_plan_t *plan)
+{
+	free(plan);
+}
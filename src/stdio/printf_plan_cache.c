@@ -0,0 +1,97 @@
+#define _GNU_SOURCE
+#include "stdio_impl.h"
+#include "pthread_impl.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+void *__malloc_heap(size_t);
+
+/* With printf_plan_cache(n), each thread keeps plans for the formats
+ * vfprintf saw last in an n-slot table indexed by the format pointer.
+ * Entries are verified against a copy of the format, since the same
+ * address may hold different text over time. A plan is taken out of
+ * its slot while in use so that nested calls, from a fopencookie
+ * write function for instance, never free it from under the caller.
+ * A miss allocates, so with the cache enabled vfprintf must not be
+ * called from signal handlers. */
+
+struct plan_cache {
+	size_t n;
+	struct __printf_plan *slot[];
+};
+
+volatile int __printf_cache_slots;
+
+static struct __printf_plan **cache_slot(struct plan_cache *c, const char *fmt)
+{
+	uintptr_t h = (uintptr_t)fmt;
+	return c->slot + ((h ^ h>>7 ^ h>>17) & c->n-1);
+}
+
+void __printf_cache_free(void)
+{
+	struct plan_cache *c = __pthread_self()->printf_cache;
+	size_t i;
+	if (!c) return;
+	__pthread_self()->printf_cache = 0;
+	for (i=0; i<c->n; i++) free(c->slot[i]);
+	free(c);
+}
+
+struct __printf_plan *__printf_cache_get(const char *fmt)
+{
+	pthread_t self = __pthread_self();
+	struct plan_cache *c = self->printf_cache;
+	struct __printf_plan **slot, *plan;
+	size_t n = __printf_cache_slots;
+
+	if (!n) return 0;
+	if (!c || c->n != n) {
+		__printf_cache_free();
+		if (!(c = __malloc_heap(sizeof *c + n*sizeof *c->slot)))
+			return 0;
+		memset(c, 0, sizeof *c + n*sizeof *c->slot);
+		c->n = n;
+		self->printf_cache = c;
+	}
+	slot = cache_slot(c, fmt);
+	if ((plan = *slot) && __printf_plan_match(plan, fmt)) {
+		*slot = 0;
+		return plan;
+	}
+
+	/* Plans must outlive any arena the thread has selected. */
+	if (!(n = __printf_plan_size(fmt)) || !(plan = __malloc_heap(n)))
+		return 0;
+	if (__printf_compile(plan, fmt)) {
+		free(plan);
+		return 0;
+	}
+	return plan;
+}
+
+void __printf_cache_put(const char *fmt, struct __printf_plan *plan)
+{
+	struct plan_cache *c = __pthread_self()->printf_cache;
+	struct __printf_plan **slot;
+	if (!c) {
+		free(plan);
+		return;
+	}
+	slot = cache_slot(c, fmt);
+	free(*slot);
+	*slot = plan;
+}
+
+int printf_plan_cache(int n)
+{
+	int k;
+	if (n < 0 || n > 4096) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (k=n ? 1 : 0; k<n; k*=2);
+	__printf_cache_slots = k;
+	return 0;
+}
@@ -0,0 +1,13 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdarg.h>
+
+int snprintf_plan(char *restrict s, size_t n, const printf_plan_t *plan, ...)
+{
+	int ret;
+	va_list ap;
+	va_start(ap, plan);
+	ret = vsnprintf_plan(s, n, plan, ap);
+	va_end(ap);
+	return ret;
+}
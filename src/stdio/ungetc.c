@@ -7,6 +7,12 @@ int ungetc(int c, FILE *f)
 	FLOCK(f);
 
 	if (!f->rpos) __toread(f);
+	/* Data served from a mapping ("m" mode) is handed back to the
+	 * file rather than written over. */
+	if (f->rpos && (f->rend < f->buf || f->rend > f->buf + f->buf_size)) {
+		if (f->seek(f, f->rpos - f->rend, SEEK_CUR) < 0) f->rpos = 0;
+		else f->rpos = f->rend = f->buf + f->buf_size;
+	}
 	if (!f->rpos || f->rpos <= f->buf - UNGET) {
 		FUNLOCK(f);
 		return EOF;
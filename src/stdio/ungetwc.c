@@ -17,6 +17,12 @@ wint_t ungetwc(wint_t c, FILE *f)
 	*ploc = f->locale;
 
 	if (!f->rpos) __toread(f);
+	/* Data served from a mapping ("m" mode) is handed back to the
+	 * file rather than written over. */
+	if (f->rpos && (f->rend < f->buf || f->rend > f->buf + f->buf_size)) {
+		if (f->seek(f, f->rpos - f->rend, SEEK_CUR) < 0) f->rpos = 0;
+		else f->rpos = f->rend = f->buf + f->buf_size;
+	}
 	if (!f->rpos || c == WEOF || (l = wcrtomb((void *)mbc, c, 0)) < 0 ||
 	    f->rpos < f->buf - UNGET + l) {
 		FUNLOCK(f);
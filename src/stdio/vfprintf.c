@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "stdio_impl.h"
 #include <errno.h>
 #include <ctype.h>
@@ -9,6 +10,9 @@
 #include <inttypes.h>
 #include <math.h>
 #include <float.h>
+#include <fenv.h>
+#include "fpdigits.h"
+#include "intdigits.h"
 
 /* Some useful macros */
 
@@ -161,13 +165,6 @@ static char *fmt_o(uintmax_t x, char *s)
 	return s;
 }
 
-static char *fmt_u(uintmax_t x, char *s)
-{
-	unsigned long y;
-	for (   ; x>ULONG_MAX; x/=10) *--s = '0' + x%10;
-	for (y=x;           y; y/=10) *--s = '0' + y%10;
-	return s;
-}
 
 /* Do not override this check. The floating point printing code below
  * depends on the float.h constants being right. If they are wrong, it
@@ -183,6 +180,7 @@ static int fmt_fp(FILE *f, long double y, int w, int p, int fl, int t)
 	uint32_t *a, *d, *r, *z;
 	int e2=0, e, i, j, l;
 	char buf[9+LDBL_MANT_DIG/4], *s;
+	double x;
 	const char *prefix="-0X+0X 0X-0x+0x 0x";
 	int pl;
 	char ebuf0[3*sizeof(int)], *ebuf=&ebuf0[3*sizeof(int)], *estr;
@@ -206,6 +204,32 @@ static int fmt_fp(FILE *f, long double y, int w, int p, int fl, int t)
 		return MAX(w, 3+pl);
 	}
 
+	/* Values representable as doubles usually round correctly with
+	 * 64-bit arithmetic; load the digits as if they came from the
+	 * expansion and rounding below. */
+	if ((t|32)!='a' && y && y==(x=y) && fegetround()==FE_TONEAREST) {
+		if (p<0) p=6;
+		if ((t|32)=='f') i = __fp_digits(x, buf, 0, -p, &e);
+		else if (p<18) i = __fp_digits(x, buf, p+((t|32)=='e' || !p), 0, &e);
+		else i = 0;
+		if (i) {
+			r = big + (e>0 ? e/9 : 0);
+			a = r - ((e+9*LDBL_MAX_EXP)/9 - LDBL_MAX_EXP);
+			for (d=r; d<a; d++) *d = 0;
+			j = e - 9*(r-a);
+			for (z=a, *z=0, s=buf; s<buf+i; s++) {
+				*z = 10 * *z + *s-'0';
+				if (!j--) j=8, *++z=0;
+			}
+			if (j<8) {
+				while (j-- >= 0) *z *= 10;
+				z++;
+			}
+			for (d=z; d<=r; d++) *d = 0;
+			goto rounded;
+		}
+	}
+
 	y = frexpl(y, &e2) * 2;
 	if (y) e2--;
 
@@ -232,7 +256,7 @@ static int fmt_fp(FILE *f, long double y, int w, int p, int fl, int t)
 			}
 		}
 
-		estr=fmt_u(e2<0 ? -e2 : e2, ebuf);
+		estr=__fmt_u(e2<0 ? -e2 : e2, ebuf);
 		if (estr==ebuf) *--estr='0';
 		*--estr = (e2<0 ? '-' : '+');
 		*--estr = t+('p'-'a');
@@ -338,6 +362,7 @@ static int fmt_fp(FILE *f, long double y, int w, int p, int fl, int t)
 		}
 		if (z>d+1) z=d+1;
 	}
+rounded:
 	for (; z>a && !z[-1]; z--);
 	
 	if ((t|32)=='g') {
@@ -366,7 +391,7 @@ static int fmt_fp(FILE *f, long double y, int w, int p, int fl, int t)
 		if (e > INT_MAX-l) return -1;
 		if (e>0) l+=e;
 	} else {
-		estr=fmt_u(e<0 ? -e : e, ebuf);
+		estr=__fmt_u(e<0 ? -e : e, ebuf);
 		while(ebuf-estr<2) *--estr='0';
 		*--estr = (e<0 ? '-' : '+');
 		*--estr = t;
@@ -382,14 +407,14 @@ static int fmt_fp(FILE *f, long double y, int w, int p, int fl, int t)
 	if ((t|32)=='f') {
 		if (a>r) a=r;
 		for (d=a; d<=r; d++) {
-			char *s = fmt_u(*d, buf+9);
+			char *s = __fmt_u(*d, buf+9);
 			if (d!=a) while (s>buf) *--s='0';
 			else if (s==buf+9) *--s='0';
 			out(f, s, buf+9-s);
 		}
 		if (p || (fl&ALT_FORM)) out(f, ".", 1);
 		for (; d<z && p>0; d++, p-=9) {
-			char *s = fmt_u(*d, buf+9);
+			char *s = __fmt_u(*d, buf+9);
 			while (s>buf) *--s='0';
 			out(f, s, MIN(9,p));
 		}
@@ -397,7 +422,7 @@ static int fmt_fp(FILE *f, long double y, int w, int p, int fl, int t)
 	} else {
 		if (z<=a) z=a+1;
 		for (d=a; d<z && p>=0; d++) {
-			char *s = fmt_u(*d, buf+9);
+			char *s = __fmt_u(*d, buf+9);
 			if (s==buf+9) *--s='0';
 			if (d!=a) while (s>buf) *--s='0';
 			else {
@@ -425,22 +450,267 @@ static int getint(char **s) {
 	return i;
 }
 
-static int printf_core(FILE *f, const char *fmt, va_list *ap, union arg *nl_arg, int *nl_type)
-{
-	char *a, *z, *s=(char *)fmt;
-	unsigned l10n=0, fl;
+/* A conversion specification. Star widths and precisions are only
+ * located by the parser: wpos and ppos are the positional argument,
+ * NEXT_ARG for the next one, or -1 when w or p was given literally. */
+
+#define NEXT_ARG -2
+
+struct spec {
+	unsigned fl;
 	int w, p, xp;
-	union arg arg;
-	int argpos;
+	int argpos, wpos, ppos;
 	unsigned st, ps;
-	int cnt=0, l=0;
+	int t;
+};
+
+static int parse_spec(char **ps, struct spec *sp, unsigned *l10n)
+{
+	char *s = *ps;
+	unsigned st, ps0;
+	int t;
+
+	if (isdigit(s[1]) && s[2]=='$') {
+		*l10n=1;
+		sp->argpos = s[1]-'0';
+		s+=3;
+	} else {
+		sp->argpos = -1;
+		s++;
+	}
+
+	/* Read modifier flags */
+	for (sp->fl=0; (unsigned)*s-' '<32 && (FLAGMASK&(1U<<*s-' ')); s++)
+		sp->fl |= 1U<<*s-' ';
+
+	/* Read field width */
+	sp->wpos = sp->ppos = -1;
+	if (*s=='*') {
+		if (isdigit(s[1]) && s[2]=='$') {
+			*l10n=1;
+			sp->wpos = s[1]-'0';
+			s+=3;
+		} else if (!*l10n) {
+			sp->wpos = NEXT_ARG;
+			s++;
+		} else goto inval;
+		sp->w = 0;
+	} else if ((sp->w=getint(&s))<0) goto overflow;
+
+	/* Read precision */
+	if (*s=='.' && s[1]=='*') {
+		if (isdigit(s[2]) && s[3]=='$') {
+			sp->ppos = s[2]-'0';
+			s+=4;
+		} else if (!*l10n) {
+			sp->ppos = NEXT_ARG;
+			s+=2;
+		} else goto inval;
+		sp->p = -1;
+		sp->xp = 0;
+	} else if (*s=='.') {
+		s++;
+		sp->p = getint(&s);
+		sp->xp = 1;
+	} else {
+		sp->p = -1;
+		sp->xp = 0;
+	}
+
+	/* Format specifier state machine */
+	st=0;
+	do {
+		if (OOB(*s)) goto inval;
+		ps0=st;
+		st=states[st]S(*s++);
+	} while (st-1<STOP);
+	if (!st) goto inval;
+
+	t = s[-1];
+
+	/* Transform ls,lc -> S,C */
+	if (ps0 && (t&15)==3) t&=~32;
+
+	sp->st = st;
+	sp->ps = ps0;
+	sp->t = t;
+	*ps = s;
+	return 0;
+
+inval:
+	errno = EINVAL;
+	return -1;
+overflow:
+	errno = EOVERFLOW;
+	return -1;
+}
+
+/* Format one argument; returns the number of bytes it produced. */
+static int fmt_arg(FILE *f, union arg arg, int w, int p, int xp, unsigned fl, int t, unsigned ps, int cnt)
+{
+	char *a, *z;
+	int l;
 	size_t i;
 	char buf[sizeof(uintmax_t)*3+3+LDBL_MANT_DIG/4];
 	const char *prefix;
-	int t, pl;
+	int pl;
 	wchar_t wc[2], *ws;
 	char mb[4];
 
+	a = z = buf + sizeof(buf);
+	prefix = "-+   0X0x";
+	pl = 0;
+
+	/* Plain integer conversions, with at most a field width and zero
+	 * padding, are assembled in buf and written in one piece. */
+	if (!xp && !(fl & ~ZERO_PAD) && w <= sizeof buf) switch(t) {
+	case 'd': case 'i':
+		if (arg.i>INTMAX_MAX) arg.i=-arg.i, pl=1;
+	case 'u':
+		a = __fmt_u(arg.i, z);
+		if (0) {
+	case 'x': case 'X':
+		a = fmt_x(arg.i, z, t&32);
+		}
+		if (a==z) *--a='0';
+		if (fl) while (z-a < w-pl) *--a='0';
+		if (pl) *--a='-';
+		while (z-a < w) *--a=' ';
+		if (z-a > INT_MAX-cnt) goto overflow;
+		out(f, a, z-a);
+		return z-a;
+	}
+
+	/* - and 0 flags are mutually exclusive */
+	if (fl & LEFT_ADJ) fl &= ~ZERO_PAD;
+
+	switch(t) {
+	case 'n':
+		switch(ps) {
+		case BARE: *(int *)arg.p = cnt; break;
+		case LPRE: *(long *)arg.p = cnt; break;
+		case LLPRE: *(long long *)arg.p = cnt; break;
+		case HPRE: *(unsigned short *)arg.p = cnt; break;
+		case HHPRE: *(unsigned char *)arg.p = cnt; break;
+		case ZTPRE: *(size_t *)arg.p = cnt; break;
+		case JPRE: *(uintmax_t *)arg.p = cnt; break;
+		}
+		return 0;
+	case 'p':
+		p = MAX(p, 2*sizeof(void*));
+		t = 'x';
+		fl |= ALT_FORM;
+	case 'x': case 'X':
+		a = fmt_x(arg.i, z, t&32);
+		if (arg.i && (fl & ALT_FORM)) prefix+=(t>>4), pl=2;
+		if (0) {
+	case 'o':
+		a = fmt_o(arg.i, z);
+		if ((fl&ALT_FORM) && p<z-a+1) p=z-a+1;
+		} if (0) {
+	case 'd': case 'i':
+		pl=1;
+		if (arg.i>INTMAX_MAX) {
+			arg.i=-arg.i;
+		} else if (fl & MARK_POS) {
+			prefix++;
+		} else if (fl & PAD_POS) {
+			prefix+=2;
+		} else pl=0;
+	case 'u':
+		a = __fmt_u(arg.i, z);
+		}
+		if (xp && p<0) goto overflow;
+		if (xp) fl &= ~ZERO_PAD;
+		if (!arg.i && !p) {
+			a=z;
+			break;
+		}
+		p = MAX(p, z-a + !arg.i);
+		break;
+	case 'c':
+		*(a=z-(p=1))=arg.i;
+		fl &= ~ZERO_PAD;
+		break;
+	case 'm':
+		if (1) a = strerror(errno); else
+	case 's':
+		a = arg.p ? arg.p : "(null)";
+		z = a + strnlen(a, p<0 ? INT_MAX : p);
+		if (p<0 && *z) goto overflow;
+		p = z-a;
+		fl &= ~ZERO_PAD;
+		break;
+	case 'C':
+		wc[0] = arg.i;
+		wc[1] = 0;
+		arg.p = wc;
+		p = -1;
+	case 'S':
+		ws = arg.p;
+		for (i=l=0; i<p && *ws && (l=wctomb(mb, *ws++))>=0 && l<=p-i; i+=l);
+		if (l<0) return -1;
+		if (i > INT_MAX) goto overflow;
+		p = i;
+		pad(f, ' ', w, p, fl);
+		ws = arg.p;
+		for (i=0; i<0U+p && *ws && i+(l=wctomb(mb, *ws++))<=p; i+=l)
+			out(f, mb, l);
+		pad(f, ' ', w, p, fl^LEFT_ADJ);
+		return w>p ? w : p;
+	case 'e': case 'f': case 'g': case 'a':
+	case 'E': case 'F': case 'G': case 'A':
+		if (xp && p<0) goto overflow;
+		l = fmt_fp(f, arg.f, w, p, fl, t);
+		if (l<0) goto overflow;
+		return l;
+	}
+
+	if (p < z-a) p = z-a;
+	if (p > INT_MAX-pl) goto overflow;
+	if (w < pl+p) w = pl+p;
+	if (w > INT_MAX-cnt) goto overflow;
+
+	pad(f, ' ', w, pl+p, fl);
+	out(f, prefix, pl);
+	pad(f, '0', w, pl+p, fl^ZERO_PAD);
+	pad(f, '0', p, z-a, 0);
+	out(f, a, z-a);
+	pad(f, ' ', w, pl+p, fl^LEFT_ADJ);
+
+	return w;
+
+overflow:
+	errno = EOVERFLOW;
+	return -1;
+}
+
+/* A compiled format: literal text and conversion specifications in
+ * order, with the types of positional arguments. Literal text refers
+ * to the copy of the format kept after the items. */
+
+struct __printf_plan {
+	const char *key;
+	char *fmt;
+	size_t n;
+	int l10n;
+	unsigned char nl_type[NL_ARGMAX+1];
+	struct item {
+		int off, len;
+		struct spec sp;
+	} item[];
+};
+
+static int printf_core(FILE *f, const char *fmt, const struct __printf_plan *plan, va_list *ap, union arg *nl_arg, int *nl_type)
+{
+	char *a, *z, *s=(char *)fmt;
+	unsigned l10n=0, fl;
+	int w, p, xp;
+	union arg arg;
+	struct spec sp;
+	int cnt=0, l=0;
+	size_t i, k=0;
+
 	for (;;) {
 		/* This error is only specified for snprintf, but since it's
 		 * unspecified for other forms, do the same. Stop immediately
@@ -449,190 +719,66 @@ static int printf_core(FILE *f, const char *fmt, va_list *ap, union arg *nl_arg,
 
 		/* Update output count, end loop when fmt is exhausted */
 		cnt += l;
-		if (!*s) break;
 
-		/* Handle literal text and %% format specifiers */
-		for (a=s; *s && *s!='%'; s++);
-		for (z=s; s[0]=='%' && s[1]=='%'; z++, s+=2);
-		if (z-a > INT_MAX-cnt) goto overflow;
-		l = z-a;
-		if (f) out(f, a, l);
-		if (l) continue;
-
-		if (isdigit(s[1]) && s[2]=='$') {
-			l10n=1;
-			argpos = s[1]-'0';
-			s+=3;
+		if (plan) {
+			if (k == plan->n) break;
+			if (!plan->item[k].sp.st) {
+				l = plan->item[k].len;
+				out(f, plan->fmt + plan->item[k++].off, l);
+				continue;
+			}
+			sp = plan->item[k++].sp;
 		} else {
-			argpos = -1;
-			s++;
+			if (!*s) break;
+
+			/* Handle literal text and %% format specifiers */
+			for (a=s; *s && *s!='%'; s++);
+			for (z=s; s[0]=='%' && s[1]=='%'; z++, s+=2);
+			if (z-a > INT_MAX-cnt) goto overflow;
+			l = z-a;
+			if (f) out(f, a, l);
+			if (l) continue;
+
+			if (parse_spec(&s, &sp, &l10n)) return -1;
 		}
 
-		/* Read modifier flags */
-		for (fl=0; (unsigned)*s-' '<32 && (FLAGMASK&(1U<<*s-' ')); s++)
-			fl |= 1U<<*s-' ';
-
-		/* Read field width */
-		if (*s=='*') {
-			if (isdigit(s[1]) && s[2]=='$') {
-				l10n=1;
-				nl_type[s[1]-'0'] = INT;
-				w = nl_arg[s[1]-'0'].i;
-				s+=3;
-			} else if (!l10n) {
+		fl = sp.fl;
+		w = sp.w;
+		p = sp.p;
+		xp = sp.xp;
+
+		if (sp.wpos != -1) {
+			if (sp.wpos >= 0) {
+				nl_type[sp.wpos] = INT;
+				w = nl_arg[sp.wpos].i;
+			} else {
 				w = f ? va_arg(*ap, int) : 0;
-				s++;
-			} else goto inval;
+			}
 			if (w<0) fl|=LEFT_ADJ, w=-w;
-		} else if ((w=getint(&s))<0) goto overflow;
-
-		/* Read precision */
-		if (*s=='.' && s[1]=='*') {
-			if (isdigit(s[2]) && s[3]=='$') {
-				nl_type[s[2]-'0'] = INT;
-				p = nl_arg[s[2]-'0'].i;
-				s+=4;
-			} else if (!l10n) {
+		}
+		if (sp.ppos != -1) {
+			if (sp.ppos >= 0) {
+				nl_type[sp.ppos] = INT;
+				p = nl_arg[sp.ppos].i;
+			} else {
 				p = f ? va_arg(*ap, int) : 0;
-				s+=2;
-			} else goto inval;
+			}
 			xp = (p>=0);
-		} else if (*s=='.') {
-			s++;
-			p = getint(&s);
-			xp = 1;
-		} else {
-			p = -1;
-			xp = 0;
 		}
 
-		/* Format specifier state machine */
-		st=0;
-		do {
-			if (OOB(*s)) goto inval;
-			ps=st;
-			st=states[st]S(*s++);
-		} while (st-1<STOP);
-		if (!st) goto inval;
-
 		/* Check validity of argument type (nl/normal) */
-		if (st==NOARG) {
-			if (argpos>=0) goto inval;
+		if (sp.st==NOARG) {
+			if (sp.argpos>=0) goto inval;
 		} else {
-			if (argpos>=0) nl_type[argpos]=st, arg=nl_arg[argpos];
-			else if (f) pop_arg(&arg, st, ap);
+			if (sp.argpos>=0) nl_type[sp.argpos]=sp.st, arg=nl_arg[sp.argpos];
+			else if (f) pop_arg(&arg, sp.st, ap);
 			else return 0;
 		}
 
 		if (!f) continue;
 
-		z = buf + sizeof(buf);
-		prefix = "-+   0X0x";
-		pl = 0;
-		t = s[-1];
-
-		/* Transform ls,lc -> S,C */
-		if (ps && (t&15)==3) t&=~32;
-
-		/* - and 0 flags are mutually exclusive */
-		if (fl & LEFT_ADJ) fl &= ~ZERO_PAD;
-
-		switch(t) {
-		case 'n':
-			switch(ps) {
-			case BARE: *(int *)arg.p = cnt; break;
-			case LPRE: *(long *)arg.p = cnt; break;
-			case LLPRE: *(long long *)arg.p = cnt; break;
-			case HPRE: *(unsigned short *)arg.p = cnt; break;
-			case HHPRE: *(unsigned char *)arg.p = cnt; break;
-			case ZTPRE: *(size_t *)arg.p = cnt; break;
-			case JPRE: *(uintmax_t *)arg.p = cnt; break;
-			}
-			continue;
-		case 'p':
-			p = MAX(p, 2*sizeof(void*));
-			t = 'x';
-			fl |= ALT_FORM;
-		case 'x': case 'X':
-			a = fmt_x(arg.i, z, t&32);
-			if (arg.i && (fl & ALT_FORM)) prefix+=(t>>4), pl=2;
-			if (0) {
-		case 'o':
-			a = fmt_o(arg.i, z);
-			if ((fl&ALT_FORM) && p<z-a+1) p=z-a+1;
-			} if (0) {
-		case 'd': case 'i':
-			pl=1;
-			if (arg.i>INTMAX_MAX) {
-				arg.i=-arg.i;
-			} else if (fl & MARK_POS) {
-				prefix++;
-			} else if (fl & PAD_POS) {
-				prefix+=2;
-			} else pl=0;
-		case 'u':
-			a = fmt_u(arg.i, z);
-			}
-			if (xp && p<0) goto overflow;
-			if (xp) fl &= ~ZERO_PAD;
-			if (!arg.i && !p) {
-				a=z;
-				break;
-			}
-			p = MAX(p, z-a + !arg.i);
-			break;
-		case 'c':
-			*(a=z-(p=1))=arg.i;
-			fl &= ~ZERO_PAD;
-			break;
-		case 'm':
-			if (1) a = strerror(errno); else
-		case 's':
-			a = arg.p ? arg.p : "(null)";
-			z = a + strnlen(a, p<0 ? INT_MAX : p);
-			if (p<0 && *z) goto overflow;
-			p = z-a;
-			fl &= ~ZERO_PAD;
-			break;
-		case 'C':
-			wc[0] = arg.i;
-			wc[1] = 0;
-			arg.p = wc;
-			p = -1;
-		case 'S':
-			ws = arg.p;
-			for (i=l=0; i<p && *ws && (l=wctomb(mb, *ws++))>=0 && l<=p-i; i+=l);
-			if (l<0) return -1;
-			if (i > INT_MAX) goto overflow;
-			p = i;
-			pad(f, ' ', w, p, fl);
-			ws = arg.p;
-			for (i=0; i<0U+p && *ws && i+(l=wctomb(mb, *ws++))<=p; i+=l)
-				out(f, mb, l);
-			pad(f, ' ', w, p, fl^LEFT_ADJ);
-			l = w>p ? w : p;
-			continue;
-		case 'e': case 'f': case 'g': case 'a':
-		case 'E': case 'F': case 'G': case 'A':
-			if (xp && p<0) goto overflow;
-			l = fmt_fp(f, arg.f, w, p, fl, t);
-			if (l<0) goto overflow;
-			continue;
-		}
-
-		if (p < z-a) p = z-a;
-		if (p > INT_MAX-pl) goto overflow;
-		if (w < pl+p) w = pl+p;
-		if (w > INT_MAX-cnt) goto overflow;
-
-		pad(f, ' ', w, pl+p, fl);
-		out(f, prefix, pl);
-		pad(f, '0', w, pl+p, fl^ZERO_PAD);
-		pad(f, '0', p, z-a, 0);
-		out(f, a, z-a);
-		pad(f, ' ', w, pl+p, fl^LEFT_ADJ);
-
-		l = w;
+		if ((l = fmt_arg(f, arg, w, p, xp, fl, sp.t, sp.ps, cnt)) < 0)
+			return -1;
 	}
 
 	if (f) return cnt;
@@ -652,7 +798,106 @@ overflow:
 	return -1;
 }
 
-int vfprintf(FILE *restrict f, const char *restrict fmt, va_list ap)
+/* Plans are built in two steps so that allocating them, and with it
+ * malloc, is left to printf_plan_create and the cache. */
+
+size_t __printf_plan_size(const char *fmt)
+{
+	struct __printf_plan *plan;
+	size_t n, len = strlen(fmt);
+	const char *s;
+
+	/* Each conversion may be preceded by one literal span */
+	for (n=1, s=fmt; (s=strchr(s, '%')); s++, n+=2);
+	if (len > INT_MAX || n > (SIZE_MAX-len-1-sizeof *plan)/sizeof *plan->item) {
+		errno = EOVERFLOW;
+		return 0;
+	}
+	return sizeof *plan + n*sizeof *plan->item + len+1;
+}
+
+int __printf_compile(struct __printf_plan *plan, const char *fmt)
+{
+	struct spec sp;
+	size_t n;
+	unsigned l10n = 0;
+	int seq = 0, pos = 0;
+	char *s, *a, *z;
+
+	/* plan has the room __printf_plan_size computed for fmt. */
+	for (n=1, s=(char *)fmt; (s=strchr(s, '%')); s++, n+=2);
+	memset(plan, 0, sizeof *plan);
+	plan->key = fmt;
+	plan->fmt = (char *)(plan->item + n);
+	strcpy(plan->fmt, fmt);
+
+	for (n=0, s=plan->fmt; *s; n++) {
+		for (a=s; *s && *s!='%'; s++);
+		for (z=s; s[0]=='%' && s[1]=='%'; z++, s+=2);
+		if (z > a) {
+			plan->item[n].off = a - plan->fmt;
+			plan->item[n].len = z - a;
+			plan->item[n].sp.st = 0;
+			continue;
+		}
+		if (parse_spec(&s, &sp, &l10n)) return -1;
+		if (sp.wpos >= 0) plan->nl_type[sp.wpos] = INT, pos = 1;
+		if (sp.ppos >= 0) plan->nl_type[sp.ppos] = INT, pos = 1;
+		if (sp.wpos == NEXT_ARG || sp.ppos == NEXT_ARG) seq = 1;
+		if (sp.st==NOARG) {
+			if (sp.argpos>=0) goto inval;
+		} else if (sp.argpos>=0) {
+			plan->nl_type[sp.argpos] = sp.st;
+			pos = 1;
+		} else seq = 1;
+		plan->item[n].sp = sp;
+	}
+	plan->n = n;
+
+	/* Positional arguments must be numbered from 1 without gaps and
+	 * cannot be mixed with sequential ones. */
+	if (pos) {
+		if (seq) goto inval;
+		for (n=1; n<=NL_ARGMAX && plan->nl_type[n]; n++);
+		for (; n<=NL_ARGMAX && !plan->nl_type[n]; n++);
+		if (n<=NL_ARGMAX) goto inval;
+		plan->l10n = 1;
+	}
+	return 0;
+
+inval:
+	errno = EINVAL;
+	return -1;
+}
+
+/* Whether plan was compiled from fmt: the same pointer, still holding
+ * the same text. */
+int __printf_plan_match(const struct __printf_plan *plan, const char *fmt)
+{
+	const char *s = plan->fmt;
+	if (plan->key != fmt) return 0;
+	for (; *s==*fmt && *s; s++, fmt++);
+	return *s==*fmt;
+}
+
+/* The plan cache lives in printf_plan_cache.c, which defines these
+ * when linked; without it vfprintf never looks for a plan. */
+
+static volatile int dummy_slots;
+weak_alias(dummy_slots, __printf_cache_slots);
+
+static struct __printf_plan *dummy_get(const char *fmt)
+{
+	return 0;
+}
+weak_alias(dummy_get, __printf_cache_get);
+
+static void dummy_put(const char *fmt, struct __printf_plan *plan)
+{
+}
+weak_alias(dummy_put, __printf_cache_put);
+
+static int do_vfprintf(FILE *restrict f, const char *restrict fmt, const struct __printf_plan *plan, va_list ap)
 {
 	va_list ap2;
 	int nl_type[NL_ARGMAX+1] = {0};
@@ -660,10 +905,14 @@ int vfprintf(FILE *restrict f, const char *restrict fmt, va_list ap)
 	unsigned char internal_buf[80], *saved_buf = 0;
 	int olderr;
 	int ret;
+	size_t i;
 
 	/* the copy allows passing va_list* even if va_list is an array */
 	va_copy(ap2, ap);
-	if (printf_core(0, fmt, &ap2, nl_arg, nl_type) < 0) {
+	if (plan) {
+		if (plan->l10n) for (i=1; i<=NL_ARGMAX && plan->nl_type[i]; i++)
+			pop_arg(nl_arg+i, plan->nl_type[i], &ap2);
+	} else if (printf_core(0, fmt, 0, &ap2, nl_arg, nl_type) < 0) {
 		va_end(ap2);
 		return -1;
 	}
@@ -677,7 +926,7 @@ int vfprintf(FILE *restrict f, const char *restrict fmt, va_list ap)
 		f->buf_size = sizeof internal_buf;
 		f->wend = internal_buf + sizeof internal_buf;
 	}
-	ret = printf_core(f, fmt, &ap2, nl_arg, nl_type);
+	ret = printf_core(f, fmt, plan, &ap2, nl_arg, nl_type);
 	if (saved_buf) {
 		f->write(f, 0, 0);
 		if (!f->wpos) ret = -1;
@@ -691,3 +940,20 @@ int vfprintf(FILE *restrict f, const char *restrict fmt, va_list ap)
 	va_end(ap2);
 	return ret;
 }
+
+int vfprintf_plan(FILE *restrict f, const printf_plan_t *plan, va_list ap)
+{
+	return do_vfprintf(f, 0, plan, ap);
+}
+
+int vfprintf(FILE *restrict f, const char *restrict fmt, va_list ap)
+{
+	struct __printf_plan *plan;
+	int ret;
+
+	if (!__printf_cache_slots) return do_vfprintf(f, fmt, 0, ap);
+	plan = __printf_cache_get(fmt);
+	ret = do_vfprintf(f, fmt, plan, ap);
+	if (plan) __printf_cache_put(fmt, plan);
+	return ret;
+}
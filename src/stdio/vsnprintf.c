@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "stdio_impl.h"
 #include <limits.h>
 #include <string.h>
@@ -32,7 +33,7 @@ static size_t sn_write(FILE *f, const unsigned char *s, size_t l)
 	return l;
 }
 
-int vsnprintf(char *restrict s, size_t n, const char *restrict fmt, va_list ap)
+static int sn_printf(char *restrict s, size_t n, const char *restrict fmt, const printf_plan_t *plan, va_list ap)
 {
 	unsigned char buf[1];
 	char dummy[1];
@@ -51,5 +52,15 @@ int vsnprintf(char *restrict s, size_t n, const char *restrict fmt, va_list ap)
 	}
 
 	*c.s = 0;
-	return vfprintf(&f, fmt, ap);
+	return plan ? vfprintf_plan(&f, plan, ap) : vfprintf(&f, fmt, ap);
+}
+
+int vsnprintf(char *restrict s, size_t n, const char *restrict fmt, va_list ap)
+{
+	return sn_printf(s, n, fmt, 0, ap);
+}
+
+int vsnprintf_plan(char *restrict s, size_t n, const printf_plan_t *plan, va_list ap)
+{
+	return sn_printf(s, n, 0, plan, ap);
 }
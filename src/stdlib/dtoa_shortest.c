@@ -0,0 +1,54 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "fpdigits.h"
+
+int dtoa_shortest(char *restrict s, size_t n, double x)
+{
+	char d[32], buf[32], *p = buf;
+	int k, e, i;
+
+	if (!isfinite(x) || !x) return snprintf(s, n, "%g", x);
+	if (signbit(x)) *p++ = '-', x = -x;
+	if (!(k = __fp_shortest(x, d, &e))) {
+		for (k=1; ; k++) {
+			snprintf(d, sizeof d, "%.*e", k-1, x);
+			if (k==17 || strtod(d, 0)==x) break;
+		}
+		e = atoi(strchr(d, 'e')+1);
+		memmove(d+1, d+2, k-1);
+	}
+	while (k>1 && d[k-1]=='0') k--;
+
+	/* Same choice of style as %.17g */
+	if (e < -4 || e >= 17) {
+		*p++ = d[0];
+		if (k>1) {
+			*p++ = '.';
+			memcpy(p, d+1, k-1);
+			p += k-1;
+		}
+		p += sprintf(p, "e%+03d", e);
+	} else if (e < 0) {
+		*p++ = '0';
+		*p++ = '.';
+		for (i=-1; i>e; i--) *p++ = '0';
+		memcpy(p, d, k);
+		p += k;
+	} else {
+		for (i=0; i<=e || i<k; i++) {
+			if (i==e+1) *p++ = '.';
+			*p++ = i<k ? d[i] : '0';
+		}
+	}
+	*p = 0;
+
+	if (n) {
+		i = p-buf < n ? p-buf : n-1;
+		memcpy(s, buf, i);
+		s[i] = 0;
+	}
+	return p-buf;
+}
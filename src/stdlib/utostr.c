@@ -0,0 +1,28 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include "intdigits.h"
+
+int utostr(char *restrict s, size_t n, unsigned long long x, int base)
+{
+	char buf[sizeof x * CHAR_BIT], *z = buf + sizeof buf, *a;
+	size_t k;
+
+	if (base < 2 || base > 36) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (base == 10) a = __fmt_u(x, z);
+	else for (a=z; x; x/=base) *--a = "0123456789abcdefghijklmnopqrstuvwxyz"[x%base];
+	if (a == z) *--a = '0';
+
+	k = z-a;
+	if (n) {
+		if (k < n) n = k+1;
+		memcpy(s, a, n-1);
+		s[n-1] = 0;
+	}
+	return k;
+}
@@ -0,0 +1,13 @@
+#include <string.h>
+
+/* Return the first p in [h, h+k) with p[0]==a and p[d]==b, or a null
+ * pointer; h[0] to h[k+d-1] must be readable. This is the candidate
+ * filter of memmem and strstr, replaced on archs with vector compares. */
+
+void *__bytepair_scan(const void *h0, size_t k, size_t d, int a, int b)
+{
+	const unsigned char *h = h0, *p;
+	for (; k && (p = memchr(h, a, k)); k -= p+1-h, h = p+1)
+		if (p[d] == (unsigned char)b) return (void *)p;
+	return 0;
+}
@@ -0,0 +1,20 @@
+#include <string.h>
+
+#define BITOP(a,b,op) \
+ ((a)[(size_t)(b)/(8*sizeof *(a))] op (size_t)1<<((size_t)(b)%(8*sizeof *(a))))
+
+/* Length of the initial segment of s made of bytes that are in the set
+ * c if accept is nonzero, or not in it otherwise; the null terminator
+ * always ends the segment. This is the scanning kernel of strspn and
+ * strcspn, replaced on archs with vector table lookups. */
+
+size_t __byteset_span(const char *s, const char *c, int accept)
+{
+	const char *a = s;
+	size_t byteset[32/sizeof(size_t)] = { 0 };
+
+	for (; *c && BITOP(byteset, *(unsigned char *)c, |=); c++);
+	if (accept) for (; *s && BITOP(byteset, *(unsigned char *)s, &); s++);
+	else for (; *s && !BITOP(byteset, *(unsigned char *)s, &); s++);
+	return s-a;
+}
@@ -0,0 +1,79 @@
+// size_t __byteset_span(const char *s, const char *set, int accept)
+//
+// The set is kept as two 16-byte tables indexed by the low nibble of a
+// byte, with a bit for each high nibble 0-7 in the first and 8-15 in
+// the second, so tbl tests 16 bytes at a time. Only aligned blocks are
+// loaded, so reads never cross into another page.
+
+.global __byteset_span
+.hidden __byteset_span
+.type __byteset_span,@function
+__byteset_span:
+	sub sp,sp,#32
+	stp xzr,xzr,[sp]
+	stp xzr,xzr,[sp,#16]
+	cbnz w2,1f
+	// spans of bytes not in the set also stop at the terminator
+	mov w3,#1
+	strb w3,[sp]
+1:	ldrb w3,[x1],#1
+	cbz w3,2f
+	and w4,w3,#15
+	lsr w5,w3,#7
+	add w4,w4,w5,lsl #4
+	ubfx w5,w3,#4,#3
+	mov w6,#1
+	lsl w6,w6,w5
+	ldrb w7,[sp,x4]
+	orr w7,w7,w6
+	strb w7,[sp,x4]
+	b 1b
+
+2:	ld1 {v0.16b,v1.16b},[sp]
+	add sp,sp,#32
+	ldr x3,=0x8040201008040201
+	fmov d2,x3
+	movi v3.16b,#15
+	movi v4.16b,#8
+	cmp w2,#0
+	csetm w3,eq
+	dup v5.16b,w3
+	bic x3,x0,#15
+	and x4,x0,#15
+	lsl x4,x4,#2
+
+.macro stops
+	ld1 {v6.16b},[x3]
+	and v7.16b,v6.16b,v3.16b
+	ushr v6.16b,v6.16b,#4
+	eor v16.16b,v6.16b,v4.16b
+	tbl v17.16b,{v0.16b},v7.16b
+	tbl v18.16b,{v1.16b},v7.16b
+	tbl v6.16b,{v2.16b},v6.16b
+	tbl v16.16b,{v2.16b},v16.16b
+	and v17.16b,v17.16b,v6.16b
+	and v18.16b,v18.16b,v16.16b
+	orr v17.16b,v17.16b,v18.16b
+	// 0xff where the byte ends the span, then 4 bits per byte
+	cmeq v17.16b,v17.16b,#0
+	eor v17.16b,v17.16b,v5.16b
+	shrn v17.8b,v17.8h,#4
+	fmov x5,d17
+.endm
+
+	stops
+	lsr x5,x5,x4
+	cbz x5,3f
+	rbit x5,x5
+	clz x5,x5
+	lsr x0,x5,#2
+	ret
+
+3:	add x3,x3,#16
+	stops
+	cbz x5,3b
+	rbit x5,x5
+	clz x5,x5
+	add x3,x3,x5,lsr #2
+	sub x0,x3,x0
+	ret
@@ -0,0 +1,39 @@
+// void *memchr(const void *s, int c, size_t n)
+//
+// Scans aligned 16-byte blocks with the count taken from the start of
+// the first block, saturating, so reads never cross into another page.
+
+.global memchr
+.type memchr,@function
+memchr:
+	cbz x2,2f
+	dup v1.16b,w1
+	bic x3,x0,#15
+	and x4,x0,#15
+	adds x2,x2,x4
+	csinv x2,x2,xzr,cc
+	ld1 {v0.16b},[x3]
+	cmeq v0.16b,v0.16b,v1.16b
+	shrn v0.8b,v0.8h,#4
+	fmov x5,d0
+	lsl x4,x4,#2
+	lsr x5,x5,x4
+	lsl x5,x5,x4
+1:	cbnz x5,3f
+	subs x2,x2,#16
+	b.ls 2f
+	add x3,x3,#16
+	ld1 {v0.16b},[x3]
+	cmeq v0.16b,v0.16b,v1.16b
+	shrn v0.8b,v0.8h,#4
+	fmov x5,d0
+	b 1b
+2:	mov x0,#0
+	ret
+3:	rbit x5,x5
+	clz x5,x5
+	lsr x5,x5,#2
+	cmp x5,x2
+	b.hs 2b
+	add x0,x3,x5
+	ret
@@ -0,0 +1,80 @@
+// void *memcpy(void *restrict dest, const void *restrict src, size_t n)
+//
+// Up to 128 bytes are copied with loads and stores from both ends that
+// may overlap in the middle; larger copies store 64 bytes per iteration
+// to the 16-byte aligned destination and finish with the last 64.
+
+.global memcpy
+.type memcpy,@function
+memcpy:
+	add x4,x1,x2
+	add x5,x0,x2
+	cmp x2,#128
+	b.hi 3f
+	cmp x2,#32
+	b.hi 2f
+	cmp x2,#16
+	b.lo 1f
+	ldr q0,[x1]
+	ldr q1,[x4,#-16]
+	str q0,[x0]
+	str q1,[x5,#-16]
+	ret
+1:	tbz x2,#3,1f
+	ldr x6,[x1]
+	ldr x7,[x4,#-8]
+	str x6,[x0]
+	str x7,[x5,#-8]
+	ret
+1:	tbz x2,#2,1f
+	ldr w6,[x1]
+	ldr w7,[x4,#-4]
+	str w6,[x0]
+	str w7,[x5,#-4]
+	ret
+1:	cbz x2,1f
+	lsr x8,x2,#1
+	ldrb w6,[x1]
+	ldrb w7,[x1,x8]
+	ldrb w9,[x4,#-1]
+	strb w6,[x0]
+	strb w7,[x0,x8]
+	strb w9,[x5,#-1]
+1:	ret
+
+2:	ldp q0,q1,[x1]
+	ldp q2,q3,[x4,#-32]
+	cmp x2,#64
+	b.hi 1f
+	stp q0,q1,[x0]
+	stp q2,q3,[x5,#-32]
+	ret
+1:	ldp q4,q5,[x1,#32]
+	ldp q6,q7,[x4,#-64]
+	stp q0,q1,[x0]
+	stp q4,q5,[x0,#32]
+	stp q6,q7,[x5,#-64]
+	stp q2,q3,[x5,#-32]
+	ret
+
+3:	ldr q0,[x1]
+	add x3,x0,#16
+	bic x3,x3,#15
+	sub x6,x3,x0
+	add x1,x1,x6
+	str q0,[x0]
+	sub x2,x5,x3
+	sub x2,x2,#64
+1:	ldp q0,q1,[x1]
+	ldp q2,q3,[x1,#32]
+	add x1,x1,#64
+	stp q0,q1,[x3]
+	stp q2,q3,[x3,#32]
+	add x3,x3,#64
+	subs x2,x2,#64
+	b.gt 1b
+	ldp q0,q1,[x4,#-64]
+	ldp q2,q3,[x4,#-32]
+	stp q0,q1,[x5,#-64]
+	stp q2,q3,[x5,#-32]
+	ret
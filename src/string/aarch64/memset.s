@@ -0,0 +1,77 @@
+// void *memset(void *dest, int c, size_t n)
+//
+// Like memcpy, small sizes store from both ends. Large zero fills use
+// dc zva when the cache line zeroing block is 64 bytes.
+
+.global memset
+.type memset,@function
+memset:
+	dup v0.16b,w1
+	add x4,x0,x2
+	cmp x2,#16
+	b.lo 1f
+	cmp x2,#128
+	b.hi 3f
+	cmp x2,#64
+	b.hi 2f
+	str q0,[x0]
+	str q0,[x4,#-16]
+	cmp x2,#32
+	b.ls 4f
+	str q0,[x0,#16]
+	str q0,[x4,#-32]
+4:	ret
+1:	fmov x3,d0
+	tbz x2,#3,1f
+	str x3,[x0]
+	str x3,[x4,#-8]
+	ret
+1:	tbz x2,#2,1f
+	str w3,[x0]
+	str w3,[x4,#-4]
+	ret
+1:	cbz x2,1f
+	strb w1,[x0]
+	strb w1,[x4,#-1]
+	tbz x2,#1,1f
+	strb w1,[x0,#1]
+1:	ret
+
+2:	stp q0,q0,[x0]
+	stp q0,q0,[x0,#32]
+	stp q0,q0,[x4,#-64]
+	stp q0,q0,[x4,#-32]
+	ret
+
+3:	str q0,[x0]
+	add x3,x0,#16
+	bic x3,x3,#15
+	sub x2,x4,x3
+	sub x2,x2,#64
+	tst w1,#255
+	b.ne 1f
+	cmp x2,#256
+	b.lo 1f
+	mrs x5,dczid_el0
+	and w5,w5,#31
+	cmp w5,#4
+	b.ne 1f
+	stp q0,q0,[x3]
+	stp q0,q0,[x3,#32]
+	add x3,x3,#64
+	bic x3,x3,#63
+	sub x2,x4,x3
+	sub x2,x2,#64
+2:	dc zva,x3
+	add x3,x3,#64
+	subs x2,x2,#64
+	b.gt 2b
+	b 4f
+1:	stp q0,q0,[x3]
+	stp q0,q0,[x3,#32]
+	add x3,x3,#64
+	subs x2,x2,#64
+	b.gt 1b
+4:	stp q0,q0,[x4,#-64]
+	stp q0,q0,[x4,#-32]
+	ret
@@ -0,0 +1,39 @@
+// char *__strchrnul(const char *s, int c)
+//
+// As strlen, stopping at either the terminator or c. strchr is built
+// on this.
+
+.global __strchrnul
+.weak strchrnul
+.type __strchrnul,@function
+.type strchrnul,@function
+__strchrnul:
+strchrnul:
+	dup v1.16b,w1
+	bic x2,x0,#15
+	ld1 {v0.16b},[x2]
+	cmeq v2.16b,v0.16b,v1.16b
+	cmeq v0.16b,v0.16b,#0
+	orr v0.16b,v0.16b,v2.16b
+	shrn v0.8b,v0.8h,#4
+	fmov x3,d0
+	lsl x4,x0,#2
+	lsr x3,x3,x4
+	cbz x3,1f
+	rbit x3,x3
+	clz x3,x3
+	add x0,x0,x3,lsr #2
+	ret
+
+1:	add x2,x2,#16
+	ld1 {v0.16b},[x2]
+	cmeq v2.16b,v0.16b,v1.16b
+	cmeq v0.16b,v0.16b,#0
+	orr v0.16b,v0.16b,v2.16b
+	shrn v0.8b,v0.8h,#4
+	fmov x3,d0
+	cbz x3,1b
+	rbit x3,x3
+	clz x3,x3
+	add x0,x2,x3,lsr #2
+	ret
@@ -0,0 +1,54 @@
+// int strcmp(const char *l, const char *r)
+//
+// Once l is aligned, 16 bytes of each string are compared at a time.
+// A block of r that would cross into another page is compared bytewise
+// instead, since the terminator may come before the boundary.
+
+.global strcmp
+.type strcmp,@function
+strcmp:
+1:	tst x0,#15
+	b.eq 2f
+	ldrb w2,[x0],#1
+	ldrb w3,[x1],#1
+	cmp w2,#1
+	ccmp w2,w3,#0,cs
+	b.eq 1b
+	sub w0,w2,w3
+	ret
+
+2:	and x4,x1,#4095
+	cmp x4,#4096-16
+	b.hi 3f
+	ld1 {v0.16b},[x0]
+	ld1 {v1.16b},[x1]
+	// nonzero where the bytes are equal and not the terminator
+	cmeq v2.16b,v0.16b,v1.16b
+	and v2.16b,v2.16b,v0.16b
+	cmeq v2.16b,v2.16b,#0
+	shrn v2.8b,v2.8h,#4
+	fmov x5,d2
+	cbnz x5,4f
+	add x0,x0,#16
+	add x1,x1,#16
+	b 2b
+
+3:	mov x6,#16
+1:	ldrb w2,[x0],#1
+	ldrb w3,[x1],#1
+	cmp w2,#1
+	ccmp w2,w3,#0,cs
+	b.ne 1f
+	subs x6,x6,#1
+	b.ne 1b
+	b 2b
+1:	sub w0,w2,w3
+	ret
+
+4:	rbit x5,x5
+	clz x5,x5
+	lsr x5,x5,#2
+	ldrb w2,[x0,x5]
+	ldrb w3,[x1,x5]
+	sub w0,w2,w3
+	ret
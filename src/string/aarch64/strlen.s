@@ -0,0 +1,32 @@
+// size_t strlen(const char *s)
+//
+// Only aligned 16-byte blocks are loaded, so reads never cross into
+// another page. shrn narrows the compare result to 4 bits per byte.
+
+.global strlen
+.type strlen,@function
+strlen:
+	bic x1,x0,#15
+	ld1 {v0.16b},[x1]
+	cmeq v0.16b,v0.16b,#0
+	shrn v0.8b,v0.8h,#4
+	fmov x2,d0
+	lsl x3,x0,#2
+	lsr x2,x2,x3
+	cbz x2,1f
+	rbit x2,x2
+	clz x2,x2
+	lsr x0,x2,#2
+	ret
+
+1:	add x1,x1,#16
+	ld1 {v0.16b},[x1]
+	cmeq v0.16b,v0.16b,#0
+	shrn v0.8b,v0.8h,#4
+	fmov x2,d0
+	cbz x2,1b
+	rbit x2,x2
+	clz x2,x2
+	sub x0,x1,x0
+	add x0,x0,x2,lsr #2
+	ret
@@ -2,6 +2,8 @@
 #include <string.h>
 #include <stdint.h>
 
+void *__bytepair_scan(const void *, size_t, size_t, int, int);
+
 static char *twobyte_memmem(const unsigned char *h, size_t k, const unsigned char *n)
 {
 	uint16_t nw = n[0]<<8 | n[1], hw = h[0]<<8 | h[1];
@@ -126,6 +128,36 @@ static char *twoway_memmem(const unsigned char *h, const unsigned char *z, const
 	}
 }
 
+/* Candidates are positions where both the first and the last byte of
+ * the needle match, found by __bytepair_scan (vectorized on some archs)
+ * and verified with memcmp. Each rejected candidate costs up to l from
+ * a budget replenished by the distance skipped; once it runs out, as
+ * with periodic needles in matching haystacks, the search continues
+ * with the linear-time algorithms above. */
+static char *pair_memmem(const unsigned char *h, size_t k, const unsigned char *n, size_t l)
+{
+	const unsigned char *z = h + k - l + 1, *p;
+	size_t budget = 4*l + 64;
+
+	for (; h < z; h = p+1) {
+		p = __bytepair_scan(h, z-h, l-1, n[0], n[l-1]);
+		if (!p) return 0;
+		if (!memcmp(p+1, n+1, l-2)) return (char *)p;
+		budget += p - h;
+		if (budget < l) {
+			h = p+1;
+			k = z-h + l-1;
+			if (k<l) return 0;
+			if (l==2) return twobyte_memmem(h, k, n);
+			if (l==3) return threebyte_memmem(h, k, n);
+			if (l==4) return fourbyte_memmem(h, k, n);
+			return twoway_memmem(h, h+k, n, l);
+		}
+		budget -= l;
+	}
+	return 0;
+}
+
 void *memmem(const void *h0, size_t k, const void *n0, size_t l)
 {
 	const unsigned char *h = h0, *n = n0;
@@ -136,14 +168,7 @@ void *memmem(const void *h0, size_t k, const void *n0, size_t l)
 	/* Return immediately when needle is longer than haystack */
 	if (k<l) return 0;
 
-	/* Use faster algorithms for short needles */
-	h = memchr(h0, *n, k);
-	if (!h || l==1) return (void *)h;
-	k -= h - (const unsigned char *)h0;
-	if (k<l) return 0;
-	if (l==2) return twobyte_memmem(h, k, n);
-	if (l==3) return threebyte_memmem(h, k, n);
-	if (l==4) return fourbyte_memmem(h, k, n);
+	if (l==1) return memchr(h0, *n, k);
 
-	return twoway_memmem(h, h+k, n, l);
+	return pair_memmem(h, k, n, l);
 }
@@ -1,6 +1,8 @@
 #include <string.h>
 #include <stdint.h>
 
+void *__bytepair_scan(const void *, size_t, size_t, int, int);
+
 static char *twobyte_strstr(const unsigned char *h, const unsigned char *n)
 {
 	uint16_t nw = n[0]<<8 | n[1], hw = h[0]<<8 | h[1];
@@ -136,20 +138,48 @@ static char *twoway_strstr(const unsigned char *h, const unsigned char *n)
 	}
 }
 
+/* As pair_memmem in memmem.c, with the haystack known to be free of
+ * null bytes up to z, which is extended as the search proceeds. */
+static char *pair_strstr(const unsigned char *h, const unsigned char *n)
+{
+	size_t l = strlen((void *)n);
+	size_t budget = 4*l + 64, grow = l + 4096;
+	const unsigned char *z = h + strnlen((void *)h, grow), *p;
+
+	for (;;) {
+		if (z-h < l) {
+			if (!*z) return 0;
+			z += strnlen((void *)z, grow);
+			continue;
+		}
+		p = __bytepair_scan(h, z-h-l+1, l-1, n[0], n[l-1]);
+		if (!p) {
+			h = z-l+1;
+			continue;
+		}
+		if (!memcmp(p+1, n+1, l-2)) return (char *)p;
+		budget += p - h;
+		h = p+1;
+		if (budget < l) break;
+		budget -= l;
+	}
+
+	while (z-h < l) {
+		if (!*z) return 0;
+		z += strnlen((void *)z, grow);
+	}
+	if (l==2) return twobyte_strstr(h, n);
+	if (l==3) return threebyte_strstr(h, n);
+	if (l==4) return fourbyte_strstr(h, n);
+	return twoway_strstr(h, n);
+}
+
 char *strstr(const char *h, const char *n)
 {
 	/* Return immediately on empty needle */
 	if (!n[0]) return (char *)h;
 
-	/* Use faster algorithms for short needles */
-	h = strchr(h, *n);
-	if (!h || !n[1]) return (char *)h;
-	if (!h[1]) return 0;
-	if (!n[2]) return twobyte_strstr((void *)h, (void *)n);
-	if (!h[2]) return 0;
-	if (!n[3]) return threebyte_strstr((void *)h, (void *)n);
-	if (!h[3]) return 0;
-	if (!n[4]) return fourbyte_strstr((void *)h, (void *)n);
-
-	return twoway_strstr((void *)h, (void *)n);
+	if (!n[1]) return strchr(h, *n);
+
+	return pair_strstr((void *)h, (void *)n);
 }
@@ -1,8 +1,16 @@
 #include <wchar.h>
+#include <string.h>
 
 wchar_t *wmemset(wchar_t *d, wchar_t c, size_t n)
 {
-	wchar_t *ret = d;
-	while (n--) *d++ = c;
-	return ret;
+	size_t k;
+
+	/* Characters made of one repeated byte, such as 0, are a memset. */
+	if ((unsigned)c == (c & 0xff) * 0x01010101U)
+		return memset(d, c, n * sizeof *d);
+
+	/* Otherwise fill a prefix and double it with memcpy. */
+	for (k=0; k<n && k<16; k++) d[k] = c;
+	for (; k<n; k*=2) memcpy(d+k, d, (n-k < k ? n-k : k) * sizeof *d);
+	return d;
 }
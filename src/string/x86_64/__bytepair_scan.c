@@ -0,0 +1,46 @@
+#include <string.h>
+#include "libc.h"
+#include "cpu_arch.h"
+
+typedef char v16 __attribute__((__vector_size__(16), __may_alias__, __aligned__(1)));
+typedef char v32 __attribute__((__vector_size__(32), __may_alias__, __aligned__(1)));
+
+/* Compare a block of candidate positions against the first byte and the
+ * block d bytes later against the second, with unaligned loads that
+ * stay inside the range the caller guarantees to be readable. */
+
+__attribute__((__target__("avx2")))
+static void *scan_avx2(const unsigned char *h, size_t k, size_t d, char a, char b)
+{
+	v32 va = (v32){0} + a, vb = (v32){0} + b;
+	unsigned m;
+
+	for (; k; h += 32, k -= 32) {
+		m = __builtin_ia32_pmovmskb256((*(v32 *)h == va) & (*(v32 *)(h+d) == vb));
+		if (m) return (void *)(h + __builtin_ctz(m));
+	}
+	return 0;
+}
+
+void *__bytepair_scan(const void *h0, size_t k, size_t d, int a, int b)
+{
+	const unsigned char *h = h0;
+	void *p;
+	v16 va = (v16){0} + (char)a, vb = (v16){0} + (char)b;
+	unsigned m;
+
+	if (__cpu_features & CPU_AVX2) {
+		size_t n = k & -32;
+		if ((p = scan_avx2(h, n, d, a, b))) return p;
+		h += n;
+		k -= n;
+	}
+	for (; k >= 16; h += 16, k -= 16) {
+		m = __builtin_ia32_pmovmskb128((*(v16 *)h == va) & (*(v16 *)(h+d) == vb));
+		if (m) return (void *)(h + __builtin_ctz(m));
+	}
+	for (; k; h++, k--)
+		if (*h == (unsigned char)a && h[d] == (unsigned char)b)
+			return (void *)h;
+	return 0;
+}
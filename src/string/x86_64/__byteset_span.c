@@ -0,0 +1,58 @@
+#include <string.h>
+#include <stdint.h>
+#include "libc.h"
+#include "cpu_arch.h"
+
+#define BITOP(a,b,op) \
+ ((a)[(size_t)(b)/(8*sizeof *(a))] op (size_t)1<<((size_t)(b)%(8*sizeof *(a))))
+
+typedef char v16 __attribute__((__vector_size__(16), __may_alias__));
+typedef unsigned char u16 __attribute__((__vector_size__(16)));
+
+/* With SSSE3, set membership is tested 16 bytes at a time. The set is
+ * kept as two 16-byte tables indexed by the low nibble of a byte, the
+ * first holding a bit for each high nibble 0-7 and the second for 8-15,
+ * and pshufb looks up both the table entries and the bit to test. Only
+ * aligned blocks are loaded, so reads never cross into another page. */
+
+__attribute__((__target__("ssse3")))
+static size_t span_ssse3(const char *s, const char *c, int accept)
+{
+	unsigned char t[32] __attribute__((__aligned__(16))) = { 0 };
+	const v16 bits = { 1, 2, 4, 8, 16, 32, 64, -128 };
+	const v16 *p = (const v16 *)((uintptr_t)s & -16);
+	v16 lo, hi, x, l, h, m;
+	unsigned stop, flip = accept ? 0xffff : 0;
+
+	/* Spans of bytes not in the set also stop at the terminator. */
+	if (!accept) t[0] = 1;
+	for (; *c; c++) {
+		unsigned char b = *c;
+		t[(b>>7)*16 + (b&15)] |= 1 << (b>>4 & 7);
+	}
+	lo = *(v16 *)t;
+	hi = *(v16 *)(t+16);
+
+	for (stop = -1U << ((uintptr_t)s & 15); ; p++, stop = -1U) {
+		x = *p;
+		l = x & 15;
+		h = (v16)((u16)x >> 4);
+		m = __builtin_ia32_pshufb128(lo, l) & __builtin_ia32_pshufb128(bits, h)
+			| __builtin_ia32_pshufb128(hi, l) & __builtin_ia32_pshufb128(bits, h^8);
+		stop &= __builtin_ia32_pmovmskb128(m != 0) ^ flip;
+		if (stop) return (const char *)p + __builtin_ctz(stop) - s;
+	}
+}
+
+size_t __byteset_span(const char *s, const char *c, int accept)
+{
+	const char *a = s;
+	size_t byteset[32/sizeof(size_t)] = { 0 };
+
+	if (__cpu_features & CPU_SSSE3) return span_ssse3(s, c, accept);
+
+	for (; *c && BITOP(byteset, *(unsigned char *)c, |=); c++);
+	if (accept) for (; *s && BITOP(byteset, *(unsigned char *)s, &); s++);
+	else for (; *s && !BITOP(byteset, *(unsigned char *)s, &); s++);
+	return s-a;
+}
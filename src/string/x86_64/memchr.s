@@ -0,0 +1,87 @@
+.global memchr
+.type memchr,@function
+memchr:
+	jmp *__memchr_impl(%rip)
+
+.global __memchr_sse2
+.hidden __memchr_sse2
+.type __memchr_sse2,@function
+__memchr_sse2:
+	test %rdx,%rdx
+	jz 3f
+	movd %esi,%xmm1
+	mov %edi,%ecx
+	mov %rdi,%rax
+	and $15,%ecx
+	and $-16,%rax
+	/* count from the aligned start, saturating */
+	add %rcx,%rdx
+	jnc 1f
+	or $-1,%rdx
+1:	punpcklbw %xmm1,%xmm1
+	punpcklwd %xmm1,%xmm1
+	pshufd $0,%xmm1,%xmm1
+	movdqa (%rax),%xmm0
+	pcmpeqb %xmm1,%xmm0
+	pmovmskb %xmm0,%r8d
+	shr %cl,%r8d
+	shl %cl,%r8d
+2:	test %r8d,%r8d
+	jnz 4f
+	sub $16,%rdx
+	jbe 3f
+	add $16,%rax
+	movdqa (%rax),%xmm0
+	pcmpeqb %xmm1,%xmm0
+	pmovmskb %xmm0,%r8d
+	jmp 2b
+3:	xor %eax,%eax
+	ret
+4:	bsf %r8d,%r8d
+	cmp %rdx,%r8
+	jae 3b
+	add %r8,%rax
+	ret
+
+.global __memchr_avx2
+.hidden __memchr_avx2
+.type __memchr_avx2,@function
+__memchr_avx2:
+	test %rdx,%rdx
+	jz 3f
+	vmovd %esi,%xmm1
+	mov %edi,%ecx
+	mov %rdi,%rax
+	and $31,%ecx
+	and $-32,%rax
+	add %rcx,%rdx
+	jnc 1f
+	or $-1,%rdx
+1:	vpbroadcastb %xmm1,%ymm1
+	vpcmpeqb (%rax),%ymm1,%ymm0
+	vpmovmskb %ymm0,%r8d
+	shr %cl,%r8d
+	shl %cl,%r8d
+2:	test %r8d,%r8d
+	jnz 4f
+	sub $32,%rdx
+	jbe 3f
+	add $32,%rax
+	vpcmpeqb (%rax),%ymm1,%ymm0
+	vpmovmskb %ymm0,%r8d
+	jmp 2b
+3:	xor %eax,%eax
+	vzeroupper
+	ret
+4:	bsf %r8d,%r8d
+	cmp %rdx,%r8
+	jae 3b
+	add %r8,%rax
+	vzeroupper
+	ret
+
+.section .data.rel.ro,"aw"
+.global __memchr_impl
+.hidden __memchr_impl
+__memchr_impl:
+	.quad __memchr_sse2
@@ -0,0 +1,87 @@
+.global memcmp
+.type memcmp,@function
+memcmp:
+	jmp *__memcmp_impl(%rip)
+
+.global __memcmp_sse2
+.hidden __memcmp_sse2
+.type __memcmp_sse2,@function
+__memcmp_sse2:
+	cmp $16,%rdx
+	jb 4f
+	/* 16-byte blocks, ending with one that overlaps the
+	 * previous block rather than reading past the end */
+1:	movdqu (%rdi),%xmm0
+	movdqu (%rsi),%xmm1
+	pcmpeqb %xmm1,%xmm0
+	pmovmskb %xmm0,%eax
+	xor $0xffff,%eax
+	jnz 3f
+	add $16,%rdi
+	add $16,%rsi
+	sub $16,%rdx
+	cmp $16,%rdx
+	jae 1b
+	test %rdx,%rdx
+	jz 2f
+	lea -16(%rdi,%rdx),%rdi
+	lea -16(%rsi,%rdx),%rsi
+	mov $16,%edx
+	jmp 1b
+2:	xor %eax,%eax
+	ret
+3:	bsf %eax,%ecx
+	movzbl (%rdi,%rcx),%eax
+	movzbl (%rsi,%rcx),%edx
+	sub %edx,%eax
+	ret
+4:	test %rdx,%rdx
+	jz 2b
+5:	movzbl (%rdi),%eax
+	movzbl (%rsi),%ecx
+	sub %ecx,%eax
+	jnz 1f
+	inc %rdi
+	inc %rsi
+	dec %rdx
+	jnz 5b
+1:	ret
+
+.global __memcmp_avx2
+.hidden __memcmp_avx2
+.type __memcmp_avx2,@function
+__memcmp_avx2:
+	cmp $32,%rdx
+	jb __memcmp_sse2
+1:	vmovdqu (%rdi),%ymm0
+	vpcmpeqb (%rsi),%ymm0,%ymm0
+	vpmovmskb %ymm0,%eax
+	not %eax
+	test %eax,%eax
+	jnz 3f
+	add $32,%rdi
+	add $32,%rsi
+	sub $32,%rdx
+	cmp $32,%rdx
+	jae 1b
+	test %rdx,%rdx
+	jz 2f
+	lea -32(%rdi,%rdx),%rdi
+	lea -32(%rsi,%rdx),%rsi
+	mov $32,%edx
+	jmp 1b
+2:	vzeroupper
+	xor %eax,%eax
+	ret
+3:	vzeroupper
+	bsf %eax,%ecx
+	movzbl (%rdi,%rcx),%eax
+	movzbl (%rsi,%rcx),%edx
+	sub %edx,%eax
+	ret
+
+.section .data.rel.ro,"aw"
+.global __memcmp_impl
+.hidden __memcmp_impl
+__memcmp_impl:
+	.quad __memcmp_sse2
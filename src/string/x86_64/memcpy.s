@@ -1,13 +1,77 @@
 .global memcpy
 .global __memcpy_fwd
 .hidden __memcpy_fwd
+.hidden __cpu_features
+.hidden __nt_store_min
 .type memcpy,@function
 memcpy:
 __memcpy_fwd:
+	/* Small and medium copies load their tail before storing
+	 * anything, so memmove may use them for overlapping forward
+	 * copies too. */
 	mov %rdi,%rax
-	cmp $8,%rdx
-	jc 1f
-	test $7,%edi
+	cmp $32,%rdx
+	ja 3f
+	cmp $16,%edx
+	jb 1f
+	movdqu (%rsi),%xmm0
+	movdqu -16(%rsi,%rdx),%xmm1
+	movdqu %xmm0,(%rdi)
+	movdqu %xmm1,-16(%rdi,%rdx)
+	ret
+1:	cmp $8,%edx
+	jb 1f
+	mov (%rsi),%rcx
+	mov -8(%rsi,%rdx),%r8
+	mov %rcx,(%rdi)
+	mov %r8,-8(%rdi,%rdx)
+	ret
+1:	cmp $4,%edx
+	jb 1f
+	mov (%rsi),%ecx
+	mov -4(%rsi,%rdx),%r8d
+	mov %ecx,(%rdi)
+	mov %r8d,-4(%rdi,%rdx)
+	ret
+1:	test %edx,%edx
+	jz 1f
+	mov %edx,%r9d
+	shr %r9d
+	movzbl (%rsi),%ecx
+	movzbl (%rsi,%r9),%r10d
+	movzbl -1(%rsi,%rdx),%r8d
+	mov %cl,(%rdi)
+	mov %r10b,(%rdi,%r9)
+	mov %r8b,-1(%rdi,%rdx)
+1:	ret
+
+3:	cmp $2048,%rdx
+	ja 4f
+	movdqu -32(%rsi,%rdx),%xmm2
+	movdqu -16(%rsi,%rdx),%xmm3
+	lea -32(%rdi,%rdx),%r8
+	sub $32,%rdx
+2:	movdqu (%rsi),%xmm0
+	movdqu 16(%rsi),%xmm1
+	movdqu %xmm0,(%rdi)
+	movdqu %xmm1,16(%rdi)
+	add $32,%rsi
+	add $32,%rdi
+	sub $32,%rdx
+	ja 2b
+	movdqu %xmm2,(%r8)
+	movdqu %xmm3,16(%r8)
+	ret
+
+4:	cmp __nt_store_min(%rip),%rdx
+	jae 5f
+	testb $8,__cpu_features(%rip)
+	jz 1f
+	mov %rdx,%rcx
+	rep
+	movsb
+	ret
+1:	test $7,%edi
 	jz 1f
 2:	movsb
 	dec %rdx
@@ -23,3 +87,41 @@ __memcpy_fwd:
 	dec %edx
 	jnz 2b
 1:	ret
+
+	/* Beyond the cache size, stream 64 bytes at a time to the
+	 * aligned destination, storing head and tail last. */
+5:	movdqu (%rsi),%xmm4
+	movdqu -16(%rsi,%rdx),%xmm5
+	lea -16(%rdi,%rdx),%r8
+	mov %edi,%ecx
+	neg %ecx
+	and $15,%ecx
+	add %rcx,%rsi
+	add %rcx,%rdi
+	sub %rcx,%rdx
+	sub $64,%rdx
+2:	prefetchnta 512(%rsi)
+	movdqu (%rsi),%xmm0
+	movdqu 16(%rsi),%xmm1
+	movdqu 32(%rsi),%xmm2
+	movdqu 48(%rsi),%xmm3
+	movntdq %xmm0,(%rdi)
+	movntdq %xmm1,16(%rdi)
+	movntdq %xmm2,32(%rdi)
+	movntdq %xmm3,48(%rdi)
+	add $64,%rsi
+	add $64,%rdi
+	sub $64,%rdx
+	jae 2b
+	sfence
+	add $48,%rdx
+	jle 1f
+2:	movdqu (%rsi),%xmm0
+	movdqa %xmm0,(%rdi)
+	add $16,%rsi
+	add $16,%rdi
+	sub $16,%rdx
+	jg 2b
+1:	movdqu %xmm4,(%rax)
+	movdqu %xmm5,(%r8)
+	ret
@@ -1,4 +1,6 @@
 .global memset
+.hidden __cpu_features
+.hidden __nt_store_min
 .type memset,@function
 memset:
 	movzbq %sil,%rax
@@ -50,6 +52,19 @@ memset:
 1:	mov %rdi,%rax
 	ret
 
+2:	cmp $2048,%rdx
+	jbe 2f
+	cmp __nt_store_min(%rip),%rdx
+	jae 3f
+	testb $8,__cpu_features(%rip)
+	jz 2f
+	mov %rdi,%r8
+	mov %rdx,%rcx
+	rep
+	stosb
+	mov %r8,%rax
+	ret
+
 2:	test $15,%edi
 	mov %rdi,%r8
 	mov %rax,-8(%rdi,%rdx)
@@ -70,3 +85,31 @@ memset:
 	sub %rdx,%rcx
 	add %rdx,%rdi
 	jmp 1b
+
+3:	movq %rax,%xmm0
+	punpcklqdq %xmm0,%xmm0
+	movdqu %xmm0,(%rdi)
+	movdqu %xmm0,-16(%rdi,%rdx)
+	mov %rdi,%r8
+	lea (%rdi,%rdx),%rdx
+	add $16,%rdi
+	and $-16,%rdi
+	and $-16,%rdx
+	sub %rdi,%rdx
+	sub $64,%rdx
+1:	movntdq %xmm0,(%rdi)
+	movntdq %xmm0,16(%rdi)
+	movntdq %xmm0,32(%rdi)
+	movntdq %xmm0,48(%rdi)
+	add $64,%rdi
+	sub $64,%rdx
+	jae 1b
+	sfence
+	add $64,%rdx
+	jz 2f
+1:	movdqa %xmm0,(%rdi)
+	add $16,%rdi
+	sub $16,%rdx
+	jnz 1b
+2:	mov %r8,%rax
+	ret
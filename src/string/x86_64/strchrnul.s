@@ -0,0 +1,87 @@
+.global __strchrnul
+.weak strchrnul
+.type __strchrnul,@function
+.type strchrnul,@function
+__strchrnul:
+strchrnul:
+	jmp *__strchrnul_impl(%rip)
+
+.global __strchrnul_sse2
+.hidden __strchrnul_sse2
+.type __strchrnul_sse2,@function
+__strchrnul_sse2:
+	movd %esi,%xmm1
+	mov %edi,%ecx
+	mov %rdi,%rax
+	punpcklbw %xmm1,%xmm1
+	punpcklwd %xmm1,%xmm1
+	pshufd $0,%xmm1,%xmm1
+	pxor %xmm2,%xmm2
+	and $15,%ecx
+	and $-16,%rax
+	movdqa (%rax),%xmm0
+	movdqa %xmm0,%xmm3
+	pcmpeqb %xmm1,%xmm0
+	pcmpeqb %xmm2,%xmm3
+	por %xmm3,%xmm0
+	pmovmskb %xmm0,%edx
+	shr %cl,%edx
+	test %edx,%edx
+	jnz 2f
+1:	add $16,%rax
+	movdqa (%rax),%xmm0
+	movdqa %xmm0,%xmm3
+	pcmpeqb %xmm1,%xmm0
+	pcmpeqb %xmm2,%xmm3
+	por %xmm3,%xmm0
+	pmovmskb %xmm0,%edx
+	test %edx,%edx
+	jz 1b
+	bsf %edx,%edx
+	add %rdx,%rax
+	ret
+2:	bsf %edx,%edx
+	lea (%rdi,%rdx),%rax
+	ret
+
+.global __strchrnul_avx2
+.hidden __strchrnul_avx2
+.type __strchrnul_avx2,@function
+__strchrnul_avx2:
+	vmovd %esi,%xmm1
+	mov %edi,%ecx
+	mov %rdi,%rax
+	vpbroadcastb %xmm1,%ymm1
+	vpxor %ymm2,%ymm2,%ymm2
+	and $31,%ecx
+	and $-32,%rax
+	vmovdqa (%rax),%ymm0
+	vpcmpeqb %ymm1,%ymm0,%ymm3
+	vpcmpeqb %ymm2,%ymm0,%ymm0
+	vpor %ymm3,%ymm0,%ymm0
+	vpmovmskb %ymm0,%edx
+	shr %cl,%edx
+	test %edx,%edx
+	jnz 2f
+1:	add $32,%rax
+	vmovdqa (%rax),%ymm0
+	vpcmpeqb %ymm1,%ymm0,%ymm3
+	vpcmpeqb %ymm2,%ymm0,%ymm0
+	vpor %ymm3,%ymm0,%ymm0
+	vpmovmskb %ymm0,%edx
+	test %edx,%edx
+	jz 1b
+	bsf %edx,%edx
+	add %rdx,%rax
+	vzeroupper
+	ret
+2:	bsf %edx,%edx
+	lea (%rdi,%rdx),%rax
+	vzeroupper
+	ret
+
+.section .data.rel.ro,"aw"
+.global __strchrnul_impl
+.hidden __strchrnul_impl
+__strchrnul_impl:
+	.quad __strchrnul_sse2
@@ -0,0 +1,89 @@
+.global strcmp
+.type strcmp,@function
+strcmp:
+	jmp *__strcmp_impl(%rip)
+
+/* Both strings are loaded unaligned, so a block is only loaded when
+ * neither would cross a page boundary; otherwise one byte is compared
+ * and the check repeated. */
+
+.global __strcmp_sse2
+.hidden __strcmp_sse2
+.type __strcmp_sse2,@function
+__strcmp_sse2:
+	pxor %xmm2,%xmm2
+	xor %edx,%edx
+1:	lea (%rdi,%rdx),%eax
+	lea (%rsi,%rdx),%ecx
+	and $4095,%eax
+	and $4095,%ecx
+	cmp $4080,%eax
+	ja 3f
+	cmp $4080,%ecx
+	ja 3f
+	movdqu (%rdi,%rdx),%xmm0
+	movdqu (%rsi,%rdx),%xmm1
+	movdqa %xmm0,%xmm3
+	pcmpeqb %xmm1,%xmm0
+	pcmpeqb %xmm2,%xmm3
+	pmovmskb %xmm0,%eax
+	pmovmskb %xmm3,%ecx
+	xor $0xffff,%eax
+	or %ecx,%eax
+	jnz 2f
+	add $16,%rdx
+	jmp 1b
+2:	bsf %eax,%eax
+	add %rax,%rdx
+3:	movzbl (%rdi,%rdx),%eax
+	movzbl (%rsi,%rdx),%ecx
+	sub %ecx,%eax
+	jnz 4f
+	test %ecx,%ecx
+	jz 4f
+	inc %rdx
+	jmp 1b
+4:	ret
+
+.global __strcmp_avx2
+.hidden __strcmp_avx2
+.type __strcmp_avx2,@function
+__strcmp_avx2:
+	vpxor %ymm2,%ymm2,%ymm2
+	xor %edx,%edx
+1:	lea (%rdi,%rdx),%eax
+	lea (%rsi,%rdx),%ecx
+	and $4095,%eax
+	and $4095,%ecx
+	cmp $4064,%eax
+	ja 3f
+	cmp $4064,%ecx
+	ja 3f
+	vmovdqu (%rdi,%rdx),%ymm0
+	vpcmpeqb (%rsi,%rdx),%ymm0,%ymm1
+	vpcmpeqb %ymm2,%ymm0,%ymm0
+	vpandn %ymm1,%ymm0,%ymm0
+	vpmovmskb %ymm0,%eax
+	not %eax
+	test %eax,%eax
+	jnz 2f
+	add $32,%rdx
+	jmp 1b
+2:	bsf %eax,%eax
+	add %rax,%rdx
+3:	movzbl (%rdi,%rdx),%eax
+	movzbl (%rsi,%rdx),%ecx
+	sub %ecx,%eax
+	jnz 4f
+	test %ecx,%ecx
+	jz 4f
+	inc %rdx
+	jmp 1b
+4:	vzeroupper
+	ret
+
+.section .data.rel.ro,"aw"
+.global __strcmp_impl
+.hidden __strcmp_impl
+__strcmp_impl:
+	.quad __strcmp_sse2
@@ -0,0 +1,65 @@
+.global strlen
+.type strlen,@function
+strlen:
+	jmp *__strlen_impl(%rip)
+
+.global __strlen_sse2
+.hidden __strlen_sse2
+.type __strlen_sse2,@function
+__strlen_sse2:
+	mov %edi,%ecx
+	mov %rdi,%rax
+	and $15,%ecx
+	and $-16,%rax
+	pxor %xmm0,%xmm0
+	pcmpeqb (%rax),%xmm0
+	pmovmskb %xmm0,%edx
+	shr %cl,%edx
+	test %edx,%edx
+	jnz 2f
+1:	add $16,%rax
+	pxor %xmm0,%xmm0
+	pcmpeqb (%rax),%xmm0
+	pmovmskb %xmm0,%edx
+	test %edx,%edx
+	jz 1b
+	bsf %edx,%edx
+	add %rdx,%rax
+	sub %rdi,%rax
+	ret
+2:	bsf %edx,%eax
+	ret
+
+.global __strlen_avx2
+.hidden __strlen_avx2
+.type __strlen_avx2,@function
+__strlen_avx2:
+	mov %edi,%ecx
+	mov %rdi,%rax
+	and $31,%ecx
+	and $-32,%rax
+	vpxor %ymm0,%ymm0,%ymm0
+	vpcmpeqb (%rax),%ymm0,%ymm1
+	vpmovmskb %ymm1,%edx
+	shr %cl,%edx
+	test %edx,%edx
+	jnz 2f
+1:	add $32,%rax
+	vpcmpeqb (%rax),%ymm0,%ymm1
+	vpmovmskb %ymm1,%edx
+	test %edx,%edx
+	jz 1b
+	bsf %edx,%edx
+	add %rdx,%rax
+	sub %rdi,%rax
+	vzeroupper
+	ret
+2:	bsf %edx,%eax
+	vzeroupper
+	ret
+
+.section .data.rel.ro,"aw"
+.global __strlen_impl
+.hidden __strlen_impl
+__strlen_impl:
+	.quad __strlen_sse2
@@ -0,0 +1,50 @@
+#include <wchar.h>
+#include <stdint.h>
+#include "libc.h"
+#include "cpu_arch.h"
+
+typedef int v4 __attribute__((__vector_size__(16), __may_alias__));
+typedef int v8 __attribute__((__vector_size__(32), __may_alias__));
+typedef char b16 __attribute__((__vector_size__(16)));
+typedef char b32 __attribute__((__vector_size__(32)));
+
+/* As wcslen, stopping at either the terminator or c. */
+
+__attribute__((__target__("avx2")))
+static const char *find_avx2(const char *p, unsigned k, wchar_t c)
+{
+	v8 vc = (v8){0} + c, v = *(v8 *)p;
+	unsigned m = __builtin_ia32_pmovmskb256((b32)((v == vc) | (v == (v8){0}))) >> k << k;
+	while (!m) {
+		p += 32;
+		v = *(v8 *)p;
+		m = __builtin_ia32_pmovmskb256((b32)((v == vc) | (v == (v8){0})));
+	}
+	return p + __builtin_ctz(m);
+}
+
+wchar_t *wcschr(const wchar_t *s, wchar_t c)
+{
+	const char *p;
+	unsigned m, k;
+	v4 vc = (v4){0} + c, v;
+
+	if (!c) return (wchar_t *)s + wcslen(s);
+
+	if (__cpu_features & CPU_AVX2) {
+		k = (uintptr_t)s & 31;
+		p = find_avx2((char *)s - k, k, c);
+	} else {
+		k = (uintptr_t)s & 15;
+		p = (char *)s - k;
+		v = *(v4 *)p;
+		m = __builtin_ia32_pmovmskb128((b16)((v == vc) | (v == (v4){0}))) >> k << k;
+		while (!m) {
+			p += 16;
+			v = *(v4 *)p;
+			m = __builtin_ia32_pmovmskb128((b16)((v == vc) | (v == (v4){0})));
+		}
+		p += __builtin_ctz(m);
+	}
+	return *(wchar_t *)p ? (wchar_t *)p : 0;
+}
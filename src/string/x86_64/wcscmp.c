@@ -0,0 +1,32 @@
+#include <wchar.h>
+#include <stdint.h>
+
+typedef int v4 __attribute__((__vector_size__(16), __may_alias__));
+typedef int u4 __attribute__((__vector_size__(16), __may_alias__, __aligned__(4)));
+typedef char b16 __attribute__((__vector_size__(16)));
+
+/* Once l is aligned, compare 4 characters at a time, loading r
+ * unaligned unless that block of r would cross into another page. */
+
+int wcscmp(const wchar_t *l, const wchar_t *r)
+{
+	v4 v;
+	unsigned m;
+
+	for (; (uintptr_t)l & 15; l++, r++)
+		if (*l != *r || !*l) return *l - *r;
+	for (;; l+=4, r+=4) {
+		if (((uintptr_t)r & 4095) > 4096-16) {
+			for (m=0; m<4; m++)
+				if (l[m] != r[m] || !l[m]) return l[m] - r[m];
+			continue;
+		}
+		v = *(v4 *)l;
+		m = __builtin_ia32_pmovmskb128((b16)((v != *(u4 *)r) | (v == (v4){0})));
+		if (m) {
+			l += __builtin_ctz(m)/4;
+			r += __builtin_ctz(m)/4;
+			return *l - *r;
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#include <wchar.h>
+#include <stdint.h>
+#include "libc.h"
+#include "cpu_arch.h"
+
+typedef int v4 __attribute__((__vector_size__(16), __may_alias__));
+typedef int v8 __attribute__((__vector_size__(32), __may_alias__));
+typedef char b16 __attribute__((__vector_size__(16)));
+typedef char b32 __attribute__((__vector_size__(32)));
+
+/* Only aligned blocks are loaded, so reads past the terminator stay in
+ * the same page. Masks have 4 bits per wide character; those for
+ * characters before s are cleared. */
+
+__attribute__((__target__("avx2")))
+static const char *find_avx2(const char *p, unsigned k)
+{
+	unsigned m = __builtin_ia32_pmovmskb256((b32)(*(v8 *)p == (v8){0})) >> k << k;
+	while (!m) {
+		p += 32;
+		m = __builtin_ia32_pmovmskb256((b32)(*(v8 *)p == (v8){0}));
+	}
+	return p + __builtin_ctz(m);
+}
+
+size_t wcslen(const wchar_t *s)
+{
+	const char *p;
+	unsigned m, k;
+
+	if (__cpu_features & CPU_AVX2) {
+		k = (uintptr_t)s & 31;
+		p = find_avx2((char *)s - k, k);
+	} else {
+		k = (uintptr_t)s & 15;
+		p = (char *)s - k;
+		m = __builtin_ia32_pmovmskb128((b16)(*(v4 *)p == (v4){0})) >> k << k;
+		while (!m) {
+			p += 16;
+			m = __builtin_ia32_pmovmskb128((b16)(*(v4 *)p == (v4){0}));
+		}
+		p += __builtin_ctz(m);
+	}
+	return (wchar_t *)p - s;
+}
@@ -0,0 +1,52 @@
+#include <wchar.h>
+#include <stdint.h>
+#include "libc.h"
+#include "cpu_arch.h"
+
+typedef int v4 __attribute__((__vector_size__(16), __may_alias__));
+typedef int v8 __attribute__((__vector_size__(32), __may_alias__));
+typedef char b16 __attribute__((__vector_size__(16)));
+typedef char b32 __attribute__((__vector_size__(32)));
+
+/* As wcslen, over aligned blocks, with the length in bytes counted from
+ * the start of the first block and saturated. */
+
+__attribute__((__target__("avx2")))
+static const char *find_avx2(const char *p, unsigned k, size_t n, wchar_t c)
+{
+	v8 vc = (v8){0} + c;
+	unsigned m = __builtin_ia32_pmovmskb256((b32)(*(v8 *)p == vc)) >> k << k;
+	while (!m) {
+		if (n <= 32) return 0;
+		n -= 32;
+		p += 32;
+		m = __builtin_ia32_pmovmskb256((b32)(*(v8 *)p == vc));
+	}
+	return __builtin_ctz(m) < n ? p + __builtin_ctz(m) : 0;
+}
+
+wchar_t *wmemchr(const wchar_t *s, wchar_t c, size_t n)
+{
+	const char *p;
+	unsigned m, k;
+	v4 vc = (v4){0} + c;
+
+	if (!n) return 0;
+	n = n < SIZE_MAX/sizeof *s - 32 ? n * sizeof *s : SIZE_MAX - 32;
+
+	if (__cpu_features & CPU_AVX2) {
+		k = (uintptr_t)s & 31;
+		return (wchar_t *)find_avx2((char *)s - k, k, n + k, c);
+	}
+	k = (uintptr_t)s & 15;
+	p = (char *)s - k;
+	n += k;
+	m = __builtin_ia32_pmovmskb128((b16)(*(v4 *)p == vc)) >> k << k;
+	while (!m) {
+		if (n <= 16) return 0;
+		n -= 16;
+		p += 16;
+		m = __builtin_ia32_pmovmskb128((b16)(*(v4 *)p == vc));
+	}
+	return __builtin_ctz(m) < n ? (wchar_t *)(p + __builtin_ctz(m)) : 0;
+}
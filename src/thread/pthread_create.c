@@ -18,6 +18,8 @@ weak_alias(dummy_0, __release_ptc);
 weak_alias(dummy_0, __pthread_tsd_run_dtors);
 weak_alias(dummy_0, __do_orphaned_stdio_locks);
 weak_alias(dummy_0, __dl_thread_cleanup);
+weak_alias(dummy_0, __printf_cache_free);
+weak_alias(dummy_0, __malloc_cache_flush);
 
 static void *dummy_1(void *p)
 {
@@ -43,6 +45,14 @@ _Noreturn void __pthread_exit(void *result)
 
 	__pthread_tsd_run_dtors();
 
+	/* Release any memory the thread still owns in libc while it is
+	 * still counted as live, so that malloc keeps locking. The
+	 * per-thread malloc cache must be drained last, after the final
+	 * free that may refill it. */
+	__dl_thread_cleanup();
+	__printf_cache_free();
+	__malloc_cache_flush();
+
 	/* Access to target the exiting thread with syscalls that use
 	 * its kernel tid is controlled by killlock. For detached threads,
 	 * any use past this point would have undefined behavior, but for
@@ -87,7 +97,6 @@ _Noreturn void __pthread_exit(void *result)
 	__vm_unlock();
 
 	__do_orphaned_stdio_locks();
-	__dl_thread_cleanup();
 
 	/* This atomic potentially competes with a concurrent pthread_detach
 	 * call; the loser is responsible for freeing thread resources. */
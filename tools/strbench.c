@@ -0,0 +1,99 @@
+/* Standalone benchmark of the string functions. For each function,
+ * size and source alignment it reports the best time per call over
+ * several runs, and the throughput. Like strtest.c it measures
+ * whatever libc it is linked against:
+ *
+ *   musl-gcc -O2 tools/strbench.c -o strbench && ./strbench
+ *
+ * Run it on an otherwise idle machine and compare against a build of
+ * the previous version rather than reading the numbers in isolation. */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define RUNS 5
+#define BYTES (64<<20)
+
+static unsigned char *src, *dst;
+
+/* Called through volatile pointers so the compiler can neither inline
+ * nor remove them. */
+static void *(*volatile f_memcpy)(void *, const void *, size_t) = memcpy;
+static void *(*volatile f_memset)(void *, int, size_t) = memset;
+static void *(*volatile f_memchr)(const void *, int, size_t) = memchr;
+static int (*volatile f_memcmp)(const void *, const void *, size_t) = memcmp;
+static size_t (*volatile f_strlen)(const char *) = strlen;
+static char *(*volatile f_strchrnul)(const char *, int) = strchrnul;
+static int (*volatile f_strcmp)(const char *, const char *) = strcmp;
+
+static volatile size_t sink;
+
+static void run_memcpy(size_t n, size_t a) { sink += (size_t)f_memcpy(dst, src + a, n); }
+static void run_memset(size_t n, size_t a) { sink += (size_t)f_memset(dst + a, 0, n); }
+static void run_memchr(size_t n, size_t a) { sink += (size_t)f_memchr(src + a, 0, n); }
+static void run_memcmp(size_t n, size_t a) { sink += f_memcmp(src + a, dst, n); }
+static void run_strlen(size_t n, size_t a) { sink += f_strlen((char *)src + a); }
+static void run_strchrnul(size_t n, size_t a) { sink += (size_t)f_strchrnul((char *)src + a, 1); }
+static void run_strcmp(size_t n, size_t a) { sink += f_strcmp((char *)src + a, (char *)dst); }
+
+static const struct {
+	const char *name;
+	void (*run)(size_t, size_t);
+	int str;
+} funcs[] = {
+	{ "memcpy", run_memcpy },
+	{ "memset", run_memset },
+	{ "memchr", run_memchr },
+	{ "memcmp", run_memcmp },
+	{ "strlen", run_strlen, 1 },
+	{ "strchrnul", run_strchrnul, 1 },
+	{ "strcmp", run_strcmp, 1 },
+};
+
+static const size_t sizes[] = { 8, 16, 32, 64, 128, 256, 1024, 4096, 65536, 1<<20 };
+static const size_t aligns[] = { 0, 1, 15 };
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+	size_t f, s, a, i, n, iters, run;
+	double t, best;
+
+	src = malloc((1<<20) + 64);
+	dst = malloc((1<<20) + 64);
+	if (!src || !dst) return 1;
+
+	printf("%-10s %8s %5s %10s %8s\n", "function", "size", "align", "ns/call", "GB/s");
+	for (f=0; f<sizeof funcs/sizeof *funcs; f++)
+	for (s=0; s<sizeof sizes/sizeof *sizes; s++)
+	for (a=0; a<sizeof aligns/sizeof *aligns; a++) {
+		n = sizes[s];
+		/* Buffers of n bytes, or strings of length n, that are
+		 * equal and contain neither 0 nor 1 before the end. */
+		memset(src, 'x', (1<<20) + 64);
+		memset(dst, 'x', (1<<20) + 64);
+		if (funcs[f].str) {
+			src[aligns[a] + n] = 0;
+			dst[n] = 0;
+		}
+		iters = BYTES / n < 1000000 ? BYTES / n : 1000000;
+		for (best=0, run=0; run<RUNS; run++) {
+			t = now();
+			for (i=0; i<iters; i++) funcs[f].run(n, aligns[a]);
+			t = now() - t;
+			if (!run || t < best) best = t;
+		}
+		printf("%-10s %8zu %5zu %10.2f %8.2f\n", funcs[f].name, n,
+			aligns[a], best / iters * 1e9, n * iters / best * 1e-9);
+	}
+	return 0;
+}
@@ -0,0 +1,297 @@
+/* Standalone check of the string functions against byte-at-a-time
+ * reference versions. Every source and destination alignment within a
+ * 64-byte block is swept, and buffers are also placed so that their
+ * last byte is the last byte before an unmapped guard page, which
+ * catches reads or writes past the end. memcpy, memmove and memset are
+ * also run at large sizes around where they change strategy, which
+ * takes a while. It tests whatever libc it is linked against, e.g.
+ * after building musl:
+ *
+ *   musl-gcc -O2 tools/strtest.c -o strtest && ./strtest
+ *
+ * or with a cross compiler and qemu for another architecture. */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define ALIGN 64
+#define MAXLEN 600
+#define MEDIUM 2048
+#define BIGMAX (512<<20)
+#define BIGGAP 4096
+
+static size_t pg;
+static unsigned char *lo, *hi, *hi2;
+static int fails;
+
+#define fail(...) do { \
+	if (fails++ < 20) printf(__VA_ARGS__); \
+} while (0)
+
+/* Positions to probe in a buffer of length n: every one near either
+ * end and about 16 in between. */
+#define step(i, n) ((i) < 8 || (n)-(i) < 8 ? 1 : (n)/16+1)
+
+/* Map len bytes followed by an inaccessible page and return the
+ * address just past the accessible part. */
+static unsigned char *guarded(size_t len)
+{
+	unsigned char *p;
+	len = (len + pg-1) & -pg;
+	p = mmap(0, len + pg, PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED || mprotect(p + len, pg, PROT_NONE)) {
+		perror("mmap");
+		exit(2);
+	}
+	return p + len;
+}
+
+static void fill(unsigned char *p, size_t n, unsigned seed)
+{
+	while (n--) *p++ = (seed = seed*1103515245 + 12345) >> 16 | 1;
+}
+
+/* Index of the first byte of p that differs from what fill stores for
+ * seed, or n if none does. */
+static size_t unfilled(const unsigned char *p, size_t n, unsigned seed)
+{
+	size_t i;
+	for (i=0; i<n; i++)
+		if (p[i] != (unsigned char)((seed = seed*1103515245 + 12345) >> 16 | 1))
+			break;
+	return i;
+}
+
+static void test_memcpy(unsigned char *d, unsigned char *s, size_t n)
+{
+	size_t i;
+	fill(s, n, n);
+	memset(d - 1, 0xee, n + 1);
+	if (memcpy(d, s, n) != d)
+		fail("memcpy(%p, %p, %zu): wrong return\n", d, s, n);
+	for (i=0; i<n && d[i]==s[i]; i++);
+	if (i < n) fail("memcpy(%p, %p, %zu): byte %zu wrong\n", d, s, n, i);
+	if (d[-1] != 0xee)
+		fail("memcpy(%p, %p, %zu): wrote before start\n", d, s, n);
+}
+
+static void test_memset(unsigned char *d, size_t n)
+{
+	static const int vals[] = { 0, 0xa5, 0x17 + 0x100 };
+	size_t i, k;
+	for (k=0; k<sizeof vals/sizeof *vals; k++) {
+		memset(d - 1, 0xee, n + 1);
+		if (memset(d, vals[k], n) != d)
+			fail("memset(%p, %d, %zu): wrong return\n", d, vals[k], n);
+		for (i=0; i<n && d[i]==(unsigned char)vals[k]; i++);
+		if (i < n) fail("memset(%p, %d, %zu): byte %zu wrong\n", d, vals[k], n, i);
+		if (d[-1] != 0xee)
+			fail("memset(%p, %d, %zu): wrote before start\n", d, vals[k], n);
+	}
+}
+
+/* memmove from s to s+k, filling s first; k may be negative. */
+static void test_memmove(unsigned char *s, ptrdiff_t k, size_t n)
+{
+	size_t i;
+	fill(s, n, n+k);
+	if (memmove(s+k, s, n) != s+k)
+		fail("memmove(%p, %p, %zu): wrong return\n", s+k, s, n);
+	if ((i = unfilled(s+k, n, n+k)) < n)
+		fail("memmove(%p, %p, %zu): byte %zu wrong\n", s+k, s, n, i);
+}
+
+static void test_memchr(unsigned char *s, size_t n)
+{
+	size_t i, j;
+	void *r;
+	fill(s, n, 3*n);
+	/* Look for a byte absent from the buffer, then for the bytes at
+	 * a spread of positions including the first and the last. */
+	if ((r = memchr(s, 0, n)))
+		fail("memchr(%p, 0, %zu) = %p, want null\n", s, n, r);
+	for (i=0; i<n; i += step(i, n)) {
+		for (j=0; s[j]!=s[i]; j++);
+		if ((r = memchr(s, s[i], n)) != s+j)
+			fail("memchr(%p, %d, %zu) = %p, want %p\n", s, s[i], n, r, s+j);
+		if ((r = memchr(s, s[i] | 0x100, n)) != s+j)
+			fail("memchr(%p, %d, %zu) = %p, want %p\n", s, s[i]|0x100, n, r, s+j);
+		if (j == i && (r = memchr(s, s[i], i)))
+			fail("memchr(%p, %d, %zu) = %p, want null\n", s, s[i], i, r);
+	}
+}
+
+static void test_str(unsigned char *s, size_t n)
+{
+	size_t i, j;
+	char *r;
+	fill(s, n, 5*n);
+	s[n] = 0;
+	if ((i = strlen((char *)s)) != n)
+		fail("strlen(%p) = %zu, want %zu\n", s, i, n);
+	if ((r = strchrnul((char *)s, 0)) != (char *)s+n)
+		fail("strchrnul(%p, 0) = %p, want %p\n", s, r, s+n);
+	if ((r = strchr((char *)s, 0)) != (char *)s+n)
+		fail("strchr(%p, 0) = %p, want %p\n", s, r, s+n);
+	for (i=0; i<n; i += step(i, n)) {
+		for (j=0; s[j]!=s[i]; j++);
+		if ((r = strchrnul((char *)s, s[i])) != (char *)s+j)
+			fail("strchrnul(%p, %d) = %p, want %p\n", s, s[i], r, s+j);
+		if ((r = strchr((char *)s, s[i])) != (char *)s+j)
+			fail("strchr(%p, %d) = %p, want %p\n", s, s[i], r, s+j);
+	}
+}
+
+static int sign(int x)
+{
+	return (x > 0) - (x < 0);
+}
+
+static void test_cmp(unsigned char *a, unsigned char *b, size_t n)
+{
+	size_t i;
+	int r;
+	fill(a, n, 7*n);
+	memcpy(b, a, n);
+	a[n] = b[n] = 0;
+	if ((r = strcmp((char *)a, (char *)b)))
+		fail("strcmp(%p, %p) = %d, want 0 (len %zu)\n", a, b, r, n);
+	if ((r = memcmp(a, b, n)))
+		fail("memcmp(%p, %p, %zu) = %d, want 0\n", a, b, n, r);
+	for (i=0; i<n; i += step(i, n)) {
+		/* Make the strings differ at i in the high bit, so that
+		 * comparing bytes as signed would get the order wrong. */
+		b[i] = a[i] ^ 0x80;
+		if (sign(strcmp((char *)a, (char *)b)) != sign(a[i] - b[i]))
+			fail("strcmp(%p, %p) wrong at %zu of %zu\n", a, b, i, n);
+		if (sign(memcmp(a, b, n)) != sign(a[i] - b[i]))
+			fail("memcmp(%p, %p, %zu) wrong at %zu\n", a, b, n, i);
+		b[i] = a[i];
+	}
+	/* A shorter string compares less. */
+	if (n) {
+		b[n-1] = 0;
+		if (strcmp((char *)a, (char *)b) <= 0)
+			fail("strcmp(%p, %p) ignores shorter b (len %zu)\n", a, b, n);
+		b[n-1] = a[n-1];
+	}
+}
+
+/* Sizes around where the x86_64 memcpy and memset change strategy:
+ * above MEDIUM bytes they use rep movs and stos, and from 3/4 of the
+ * largest cache non-temporal stores. The library sizes its caches
+ * with cpuid and the test reads them from sysfs, which should agree;
+ * smaller powers of two are tried as well. On other architectures
+ * these are just large sizes. */
+static size_t big_sizes(size_t *v)
+{
+	static const int near[] = { -1, 0, 1, 65 };
+	size_t k = 0, i, j, t;
+	char path[64], unit;
+	FILE *f;
+
+	for (t=MEDIUM; t<=BIGMAX/64; t*=2)
+		for (i=0; i<sizeof near/sizeof *near; i++)
+			v[k++] = t + near[i];
+	for (j=0; j<8; j++) {
+		snprintf(path, sizeof path,
+			"/sys/devices/system/cpu/cpu0/cache/index%zu/size", j);
+		if (!(f = fopen(path, "r"))) break;
+		if (fscanf(f, "%zu%c", &t, &unit) == 2 && (unit=='K' || unit=='M')) {
+			t = (t << (unit=='K' ? 10 : 20)) / 4 * 3;
+			if (t <= BIGMAX) {
+				v[k++] = t-1;
+				v[k++] = t;
+			}
+		}
+		fclose(f);
+	}
+	return k;
+}
+
+static void test_big(void)
+{
+	static const struct { unsigned char d, s; } al[] = {
+		{ 0, 0 }, { 17, 63 }, { 1, 0 }, { 0, 1 },
+	};
+	static const int shift[] = { 1, 64, 15, 4095 };
+	size_t v[128], cnt, max = 0, i, j, m, n;
+	unsigned char *a, *b;
+
+	cnt = big_sizes(v);
+	for (i=0; i<cnt; i++) if (v[i] > max) max = v[i];
+	a = guarded(max + 2*BIGGAP) - max - 2*BIGGAP;
+	b = guarded(max + ALIGN);
+
+	for (i=0; i<cnt; i++) {
+		n = v[i];
+		/* Only a couple of cases once sizes take a while */
+		m = n > BIGMAX/64 ? 2 : 4;
+		/* Destination, then source, ending at a guard page */
+		for (j=0; j<m; j++) {
+			test_memcpy(b - n - al[j].d, a + BIGGAP + al[j].s, n);
+			test_memcpy(a + BIGGAP + al[j].d, b - n - al[j].s, n);
+			test_memset(b - n - al[j].d, n);
+		}
+		/* Overlapping moves in both directions */
+		for (j=0; j<m; j++) {
+			test_memmove(a + BIGGAP, -shift[j], n);
+			test_memmove(a + BIGGAP, shift[j], n);
+		}
+	}
+}
+
+int main(void)
+{
+	size_t n, i, j;
+
+	pg = sysconf(_SC_PAGESIZE);
+	lo = guarded(MAXLEN + 3*ALIGN) - (MAXLEN + 3*ALIGN);
+	hi = guarded(MAXLEN + 2*ALIGN);
+	hi2 = guarded(MAXLEN + 2*ALIGN);
+
+	/* All alignment pairs, away from any page boundary. */
+	for (i=0; i<ALIGN; i++) for (j=0; j<ALIGN; j++)
+		for (n=0; n<=MAXLEN; n += n<2*ALIGN+8 ? 1 : 37) {
+			test_memcpy(lo + ALIGN + i, hi - MAXLEN - ALIGN + j, n);
+			if (!i) test_cmp(lo + ALIGN + j, hi2 - MAXLEN - ALIGN + i, n);
+			else if (j < 2) test_cmp(lo + ALIGN + i, hi2 - MAXLEN - ALIGN + j*17, n);
+		}
+	for (i=0; i<ALIGN; i++)
+		for (n=0; n<=MAXLEN; n++) {
+			test_memset(lo + ALIGN + i, n);
+			test_memchr(lo + ALIGN + i, n);
+			test_str(lo + ALIGN + i, n);
+		}
+
+	/* Buffers whose last byte, or a string whose terminator, is right
+	 * before the guard page; the start alignment varies with n. */
+	for (n=0; n<=MAXLEN; n++) {
+		for (i=0; i<ALIGN; i++) {
+			test_memcpy(hi - n, lo + ALIGN + i, n);
+			test_memcpy(lo + ALIGN + i, hi - n, n);
+		}
+		test_memcpy(hi - n, hi2 - n, n);
+		test_memset(hi - n, n);
+		test_memchr(hi - n, n);
+		test_str(hi - n - 1, n);
+		test_cmp(hi - n - 1, hi2 - n - 1, n);
+		for (i=1; i<ALIGN && i<=n; i+=7) {
+			test_cmp(hi - n - 1, hi2 - n - 1 + i, n - i);
+			test_cmp(hi - n - 1 + i, hi2 - n - 1, n - i);
+		}
+	}
+
+	test_big();
+
+	if (fails) printf("%d failures\n", fails);
+	else printf("ok\n");
+	return !!fails;
+}